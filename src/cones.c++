@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of flo-llvm.
+ *
+ * flo-llvm is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * flo-llvm is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with flo-llvm.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "cones.h++"
+#include <libflo/sizet_printf.h++>
+#include <algorithm>
+#include <set>
+
+#ifndef BUFFER_SIZE
+#define BUFFER_SIZE 1024
+#endif
+
+cones::cone::cone(bool always)
+    : _ops(),
+      _imports(),
+      _nexts(),
+      _always(always)
+{
+}
+
+cones::cones(const flo_ptr flo)
+    : _cones(),
+      _retained(),
+      _is_retained(),
+      _triggers()
+{
+    /* The first cone holds everything that doesn't read any nodes at
+     * all (which can't ever be triggered), so it's always evaluated. */
+    _cones.push_back(cone(true));
+
+    std::map<std::string, size_t> placed;
+    std::vector<std::set<std::string>> imported(1);
+    std::map<std::string, std::vector<size_t>> mem_reads;
+    std::map<std::string, size_t> mem_write;
+
+    for (const auto& op: flo->operations()) {
+        /* IN and REG operations are just loads from the state, which
+         * every cone that needs them performs itself. */
+        if (op->op() == libflo::opcode::IN)
+            continue;
+        if (op->op() == libflo::opcode::REG)
+            continue;
+
+        std::vector<std::shared_ptr<node>> inputs;
+        for (const auto& n: op->sources())
+            if (n->is_const() == false)
+                inputs.push_back(n);
+
+        bool is_rd = (op->op() == libflo::opcode::RD);
+        bool is_wr = (op->op() == libflo::opcode::WR);
+        bool always = is_rd || is_wr;
+
+        /* Cones are evaluated in order, so an operation can't go into
+         * a cone before anything it depends on.  Memories are
+         * accessed in place, so that includes their earlier
+         * accesses. */
+        size_t latest = 0;
+        bool has_deps = false;
+        for (const auto& n: inputs) {
+            auto l = placed.find(n->name());
+            if (l != placed.end()) {
+                latest = std::max(latest, l->second);
+                has_deps = true;
+            }
+        }
+        if (is_rd || is_wr) {
+            auto mem = op->t()->name();
+
+            auto l = mem_write.find(mem);
+            if (l != mem_write.end())
+                latest = std::max(latest, l->second);
+
+            if (is_wr)
+                for (const auto& r: mem_reads[mem])
+                    latest = std::max(latest, r);
+        }
+
+        /* Returns TRUE if this operation can be added to the given
+         * cone without it needing too many triggers. */
+        auto fits = [&](size_t c) -> bool {
+            if (_cones[c]._always != always)
+                return false;
+            if (always == true)
+                return true;
+
+            auto imports = imported[c];
+            for (const auto& n: inputs) {
+                auto l = placed.find(n->name());
+                if (l == placed.end() || l->second != c)
+                    imports.insert(n->name());
+            }
+            return imports.size() <= max_triggers;
+        };
+
+        size_t c;
+        if (inputs.size() == 0 && always == false)
+            c = 0;
+        else if (has_deps == true && fits(latest) == true)
+            c = latest;
+        else if (_cones.size() > 1 && fits(_cones.size() - 1) == true)
+            c = _cones.size() - 1;
+        else {
+            c = _cones.size();
+            _cones.push_back(cone(always));
+            imported.push_back(std::set<std::string>());
+        }
+
+        auto& into = _cones[c];
+        into._ops.push_back(op);
+        for (const auto& n: inputs) {
+            auto l = placed.find(n->name());
+            if (l != placed.end() && l->second == c)
+                continue;
+            if (imported[c].find(n->name()) != imported[c].end())
+                continue;
+
+            imported[c].insert(n->name());
+            into._imports.push_back(n);
+        }
+        placed[op->d()->name()] = c;
+
+        if (is_wr) {
+            mem_write[op->t()->name()] = c;
+            mem_reads[op->t()->name()].clear();
+        }
+        if (is_rd)
+            mem_reads[op->t()->name()].push_back(c);
+    }
+
+    /* The next value of a register is stored by whichever cone
+     * computes it, as it only changes when that cone is evaluated.
+     * The rest are just copies of nodes that live in the state. */
+    for (const auto& op: flo->operations()) {
+        if (op->op() != libflo::opcode::REG)
+            continue;
+
+        auto l = placed.find(op->t()->name());
+        size_t c = (l == placed.end()) ? 0 : l->second;
+        _cones[c]._nexts.push_back(op);
+
+        if (op->t()->is_const() == true || l != placed.end())
+            continue;
+        if (imported[c].find(op->t()->name()) != imported[c].end())
+            continue;
+
+        imported[c].insert(op->t()->name());
+        _cones[c]._imports.push_back(op->t());
+    }
+
+    /* Anything that's used by another cone must be kept in the
+     * state, and anything that triggers a cone must also have its
+     * last value kept. */
+    std::set<std::string> triggered;
+    for (const auto& cone: _cones) {
+        for (const auto& n: cone._imports) {
+            if (placed.find(n->name()) != placed.end()
+                && n->exported() == false
+                && _is_retained.find(n->name()) == _is_retained.end()) {
+                _is_retained[n->name()] = true;
+                _retained.push_back(n);
+            }
+
+            if (cone._always == true)
+                continue;
+
+            if (triggered.find(n->name()) != triggered.end())
+                continue;
+            triggered.insert(n->name());
+            _triggers.push_back(n);
+        }
+    }
+}
+
+bool cones::is_retained(const std::shared_ptr<node> n) const
+{
+    return _is_retained.find(n->name()) != _is_retained.end();
+}
+
+const std::string cones::function_name(const flo_ptr flo, size_t i) const
+{
+    char buffer[BUFFER_SIZE];
+    snprintf(buffer, BUFFER_SIZE,
+             "_llvmflo_%s_clock_lo_cone_" SIZET_FORMAT,
+             flo->class_name().c_str(),
+             i);
+    return buffer;
+}
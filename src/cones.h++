@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of flo-llvm.
+ *
+ * flo-llvm is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * flo-llvm is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with flo-llvm.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CONES_HXX
+#define CONES_HXX
+
+#include "flo.h++"
+#include "node.h++"
+#include "operation.h++"
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+/* Splits the operations that make up clock_lo into cones of logic,
+ * each of which only needs to be evaluated when one of the nodes it
+ * reads (its triggers) changed since the last cycle.  Everything a
+ * cone computes that's needed outside of it is kept in the state, so
+ * skipping a cone just leaves last cycle's results in place.
+ *
+ * Operations are placed greedily in dataflow order: each one joins
+ * the cone of its latest producer (or the latest cone) as long as
+ * that doesn't give the cone too many triggers, and otherwise starts
+ * a new cone.  Reading a memory depends on more than just the nodes
+ * that are passed to it, so RD and WR operations go into cones that
+ * are evaluated every cycle. */
+class cones {
+public:
+    /* Checking whether a cone needs to be evaluated costs a compare
+     * for every trigger, so this bounds that overhead. */
+    static const size_t max_triggers = 8;
+
+    /* When more than this percentage of the cones are evaluated in a
+     * single cycle the next few cycles just evaluate everything, as
+     * it's cheaper than checking. */
+    static const size_t full_percent = 50;
+    static const size_t full_cycles = 64;
+
+    /* A single cone of logic. */
+    class cone {
+    private:
+        std::vector<std::shared_ptr<operation>> _ops;
+        std::vector<std::shared_ptr<node>> _imports;
+        std::vector<std::shared_ptr<operation>> _nexts;
+        bool _always;
+
+    public:
+        cone(bool always);
+
+    public:
+        /* The operations in this cone, in dataflow order. */
+        const std::vector<std::shared_ptr<operation>>& ops(void) const
+            { return _ops; }
+
+        /* The nodes that this cone uses but doesn't compute, which
+         * are also the triggers of cones that aren't always
+         * evaluated. */
+        const std::vector<std::shared_ptr<node>>& imports(void) const
+            { return _imports; }
+
+        /* The registers whose next value is stored by this cone. */
+        const std::vector<std::shared_ptr<operation>>& nexts(void) const
+            { return _nexts; }
+
+        /* TRUE if this cone is evaluated every cycle. */
+        bool always(void) const { return _always; }
+
+        friend class cones;
+    };
+
+private:
+    std::vector<cone> _cones;
+    std::vector<std::shared_ptr<node>> _retained;
+    std::map<std::string, bool> _is_retained;
+    std::vector<std::shared_ptr<node>> _triggers;
+
+public:
+    /* Splits the given design into cones. */
+    cones(const flo_ptr flo);
+
+public:
+    size_t size(void) const { return _cones.size(); }
+    const cone& at(size_t i) const { return _cones[i]; }
+
+    /* The nodes that are computed by one cone and used by another,
+     * but wouldn't otherwise be stored in the state. */
+    const std::vector<std::shared_ptr<node>>& retained(void) const
+        { return _retained; }
+    bool is_retained(const std::shared_ptr<node> n) const;
+
+    /* Every node that triggers some cone, each of which needs its
+     * value from the last cycle to be kept around. */
+    const std::vector<std::shared_ptr<node>>& triggers(void) const
+        { return _triggers; }
+
+    /* Returns the name of the LLVM function for a cone. */
+    const std::string function_name(const flo_ptr flo, size_t i) const;
+};
+
+#endif
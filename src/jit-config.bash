@@ -0,0 +1,45 @@
+#!/bin/bash
+
+# Prints the flags needed to build the in-process JIT (see jit.c++).
+# That code is written against LLVM 3.5's API, so when there isn't a
+# 3.5 llvm-config this prints nothing and flo-llvm is just built
+# without --jit.  Setting LLVM_CONFIG picks a specific llvm-config,
+# or disables the JIT entirely when it's set to "false".
+
+llvm_config=""
+for c in $LLVM_CONFIG llvm-config llvm-config-3.5
+do
+    if [[ "$($c --version 2>/dev/null)" == 3.5* ]]
+    then
+        llvm_config="$c"
+        break
+    fi
+
+    if [[ "$LLVM_CONFIG" != "" ]]
+    then
+        break
+    fi
+done
+
+if [[ "$llvm_config" == "" ]]
+then
+    exit 0
+fi
+
+if [[ "$1" == "--cflags" ]]
+then
+    # LLVM's headers are treated as system headers so they don't trip
+    # the warnings flo-llvm is built with.
+    echo "-DHAVE_LLVM_JIT"
+    echo "-isystem $($llvm_config --includedir)"
+    echo "-D__STDC_CONSTANT_MACROS -D__STDC_LIMIT_MACROS"
+    exit 0
+fi
+
+if [[ "$1" == "--libs" ]]
+then
+    $llvm_config --ldflags --libs --system-libs
+    exit 0
+fi
+
+exit 1
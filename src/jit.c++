@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of flo-llvm.
+ *
+ * flo-llvm is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * flo-llvm is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with flo-llvm.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "jit.h++"
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef HAVE_LLVM_JIT
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/ExecutionEngine/MCJIT.h>
+#include <llvm/IR/DataLayout.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IRReader/IRReader.h>
+#include <llvm/PassManager.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/FormattedStream.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/SourceMgr.h>
+#include <llvm/Support/TargetRegistry.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
+#include <llvm/Target/TargetOptions.h>
+#include <llvm/Transforms/IPO.h>
+#include <llvm/Transforms/IPO/PassManagerBuilder.h>
+
+bool jit::supported(void)
+{
+    return true;
+}
+
+jit::jit(const std::string ir)
+    : _context(new llvm::LLVMContext()),
+      _module(NULL),
+      _target(NULL),
+      _engine(NULL)
+{
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+    llvm::InitializeNativeTargetAsmParser();
+
+    /* The IR is parsed straight out of memory, so it never needs to
+     * hit the disk. */
+    llvm::SMDiagnostic diag;
+    auto buffer = llvm::MemoryBuffer::getMemBuffer(ir, "flo-llvm");
+    _module = llvm::ParseIR(buffer, diag, *_context);
+    if (_module == NULL) {
+        diag.print("flo-llvm", llvm::errs());
+        abort();
+    }
+
+    auto triple = llvm::sys::getProcessTriple();
+    std::string error;
+    auto target = llvm::TargetRegistry::lookupTarget(triple, error);
+    if (target == NULL) {
+        fprintf(stderr, "Unable to find target '%s': %s\n",
+                triple.c_str(), error.c_str());
+        abort();
+    }
+
+    llvm::TargetOptions options;
+    _target = target->createTargetMachine(triple,
+                                          llvm::sys::getHostCPUName(),
+                                          "",
+                                          options,
+                                          llvm::Reloc::PIC_,
+                                          llvm::CodeModel::Default,
+                                          llvm::CodeGenOpt::Aggressive);
+
+    _module->setTargetTriple(triple);
+    _module->setDataLayout(_target->getDataLayout());
+}
+
+jit::~jit(void)
+{
+    /* The execution engine owns the module once it's been created. */
+    if (_engine != NULL)
+        delete _engine;
+    else
+        delete _module;
+
+    delete _target;
+    delete _context;
+}
+
+void jit::optimize(unsigned level)
+{
+    llvm::PassManagerBuilder builder;
+    builder.OptLevel = level;
+    builder.Inliner = llvm::createFunctionInliningPass(level, 0);
+
+    llvm::FunctionPassManager fpm(_module);
+    fpm.add(new llvm::DataLayoutPass(_module));
+    builder.populateFunctionPassManager(fpm);
+
+    llvm::PassManager mpm;
+    mpm.add(new llvm::DataLayoutPass(_module));
+    builder.populateModulePassManager(mpm);
+
+    fpm.doInitialization();
+    for (auto it = _module->begin(); it != _module->end(); ++it)
+        fpm.run(*it);
+    fpm.doFinalization();
+
+    mpm.run(*_module);
+}
+
+void jit::write_object(const std::string filename)
+{
+    std::string error;
+    llvm::raw_fd_ostream out(filename.c_str(), error, llvm::sys::fs::F_None);
+    if (error.size() != 0) {
+        fprintf(stderr, "Unable to open '%s': %s\n",
+                filename.c_str(), error.c_str());
+        abort();
+    }
+
+    llvm::formatted_raw_ostream fout(out);
+
+    llvm::PassManager pm;
+    pm.add(new llvm::DataLayoutPass(_module));
+    if (_target->addPassesToEmitFile(pm, fout,
+                                     llvm::TargetMachine::CGFT_ObjectFile)) {
+        fprintf(stderr, "Target can't emit object files\n");
+        abort();
+    }
+
+    pm.run(*_module);
+}
+
+uintptr_t jit::function(const std::string name)
+{
+    if (_engine == NULL) {
+        std::string error;
+        llvm::EngineBuilder builder(_module);
+        builder.setEngineKind(llvm::EngineKind::JIT);
+        builder.setUseMCJIT(true);
+        builder.setErrorStr(&error);
+        builder.setOptLevel(llvm::CodeGenOpt::Aggressive);
+        _engine = builder.create();
+
+        if (_engine == NULL) {
+            fprintf(stderr, "Unable to create JIT: %s\n", error.c_str());
+            abort();
+        }
+
+        _engine->finalizeObject();
+    }
+
+    auto addr = _engine->getFunctionAddress(name);
+    if (addr == 0) {
+        fprintf(stderr, "Unable to find function '%s'\n", name.c_str());
+        abort();
+    }
+
+    return addr;
+}
+#else
+/* Without LLVM there's no way to build anything in-process, so main()
+ * refuses --jit before any of these can be called. */
+bool jit::supported(void)
+{
+    return false;
+}
+
+jit::jit(const std::string)
+    : _context(NULL),
+      _module(NULL),
+      _target(NULL),
+      _engine(NULL)
+{
+    abort();
+}
+
+jit::~jit(void)
+{
+}
+
+void jit::optimize(unsigned)
+{
+    abort();
+}
+
+void jit::write_object(const std::string)
+{
+    abort();
+}
+
+uintptr_t jit::function(const std::string)
+{
+    abort();
+}
+#endif
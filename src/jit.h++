@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of flo-llvm.
+ *
+ * flo-llvm is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * flo-llvm is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with flo-llvm.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef JIT_HXX
+#define JIT_HXX
+
+#include <stdint.h>
+#include <string>
+
+/* LLVM's headers are only needed by the implementation, so this just
+ * forward declares the bits that get stored here. */
+namespace llvm {
+    class ExecutionEngine;
+    class LLVMContext;
+    class Module;
+    class TargetMachine;
+}
+
+/* Holds a single LLVM module in memory, which allows the whole
+ * Flo->native flow to run inside this process rather than shelling
+ * out to opt/llc and passing text IR around in files. */
+class jit {
+private:
+    llvm::LLVMContext *_context;
+    llvm::Module *_module;
+    llvm::TargetMachine *_target;
+    llvm::ExecutionEngine *_engine;
+
+public:
+    /* Returns TRUE if flo-llvm was built against LLVM, which is the
+     * only way any of the rest of this works. */
+    static bool supported(void);
+
+public:
+    /* Parses the given LLVM IR (in text form) into a module for the
+     * host machine. */
+    jit(const std::string ir);
+    ~jit(void);
+
+public:
+    /* Runs the standard LLVM optimization pipeline at the given
+     * level, which should match what "opt -O<level>" does. */
+    void optimize(unsigned level);
+
+    /* Generates native code for the module and writes it out as an
+     * object file. */
+    void write_object(const std::string filename);
+
+    /* Generates native code for the module inside this process and
+     * returns the address of the given function.  Note that after
+     * this the module can't be written out anymore. */
+    uintptr_t function(const std::string name);
+};
+
+#endif
@@ -30,6 +30,14 @@
  * I don't understand C++'s template metaprogramming well enough to
  * write that while I'm on an airplane without internet access... */
 namespace libcodegen {
+    class arglist0 {
+    public:
+        const std::vector<std::string> as_llvm(void) const
+            {
+                return std::vector<std::string>();
+            }
+    };
+
     template<class A>
     class arglist1 {
     private:
@@ -21,6 +21,7 @@
 
 #include "fix.h++"
 #include <libflo/sizet_printf.h++>
+#include <ctype.h>
 #include <stdlib.h>
 using namespace libcodegen;
 
@@ -28,13 +29,63 @@ using namespace libcodegen;
 #define BUFFER_SIZE 1024
 #endif
 
+static size_t lanes_count = 1;
+
+void fix_t::set_lanes(size_t lanes)
+{
+    lanes_count = lanes;
+}
+
+size_t fix_t::lanes(void)
+{
+    return lanes_count;
+}
+
 const std::string fix_t::as_llvm(void) const
 {
     char buffer[BUFFER_SIZE];
-    snprintf(buffer, BUFFER_SIZE, "i" SIZET_FORMAT, _width);
+    if (lanes_count > 1) {
+        snprintf(buffer, BUFFER_SIZE, "<" SIZET_FORMAT " x i" SIZET_FORMAT ">",
+                 lanes_count, _width);
+    } else {
+        snprintf(buffer, BUFFER_SIZE, "i" SIZET_FORMAT, _width);
+    }
     return buffer;
 }
 
+const std::string fix_t::llvm_name(void) const
+{
+    if (isdigit(name().c_str()[0]) || name().c_str()[0] == '-')
+        return constant_llvm(name());
+
+    return value::llvm_name();
+}
+
+const std::string fix_t::constant_llvm(const std::string literal) const
+{
+    if (lanes_count <= 1)
+        return literal;
+
+    char element[BUFFER_SIZE];
+    snprintf(element, BUFFER_SIZE, "i" SIZET_FORMAT " %s",
+             _width, literal.c_str());
+
+    std::string out = "<";
+    for (size_t i = 0; i < lanes_count; ++i) {
+        if (i != 0)
+            out += ", ";
+        out += element;
+    }
+    out += ">";
+
+    return out;
+}
+
+const std::string fix_ptr_t::as_llvm(void) const
+{
+    return fix_t(_width, "").as_llvm() + "*";
+}
+
 fix_t& fix_t::operator=(const fix_t& i)
 {
     this->_width = i._width;
@@ -48,12 +48,40 @@ namespace libcodegen {
 
         size_t width(void) const { return _width; }
 
+        /* Sets the number of independent lanes that every fix_t
+         * holds.  With more than one lane every fix_t is really an
+         * LLVM vector, with one element per lane. */
+        static void set_lanes(size_t lanes);
+        static size_t lanes(void);
+
         /* FIXME: This shouldn't be necessary, but it appears that old
          * GCC versions won't construct a default operator= here.  I
          * have no idea why... */
         fix_t& operator=(const fix_t& i);
 
         const std::string as_llvm(void) const;
+
+        /* Constants need to be splatted across every lane. */
+        virtual const std::string llvm_name(void) const;
+        virtual const std::string constant_llvm(const std::string literal) const;
+    };
+
+    /* A pointer to a fix_t, which needs its own class because the
+     * width of a fix_t is only known at runtime. */
+    class fix_ptr_t: public value {
+    private:
+        size_t _width;
+
+    public:
+        fix_ptr_t(size_t width)
+            : value(),
+              _width(width)
+            {
+            }
+
+        size_t width(void) const { return _width; }
+
+        const std::string as_llvm(void) const;
     };
 
     /* Represents a fixed width integer whose width is known at
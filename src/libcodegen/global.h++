@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of flo-llvm.
+ *
+ * flo-llvm is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * flo-llvm is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with flo-llvm.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBCODEGEN__GLOBAL_HXX
+#define LIBCODEGEN__GLOBAL_HXX
+
+#include "pointer.h++"
+#include <string>
+
+namespace libcodegen {
+    /* A pointer to a global variable.  These are always named, and
+     * LLVM names them differently than the values in a function. */
+    template<class V> class global: public pointer<V> {
+    public:
+        global(const std::string name)
+            : pointer<V>(name)
+            {
+            }
+
+        virtual const std::string llvm_name(void) const
+            { return "@" + this->name(); }
+    };
+}
+
+#endif
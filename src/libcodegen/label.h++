@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of flo-llvm.
+ *
+ * flo-llvm is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * flo-llvm is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with flo-llvm.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef LIBCODEGEN__LABEL_HXX
+#define LIBCODEGEN__LABEL_HXX
+
+#include "value.h++"
+#include <string>
+
+namespace libcodegen {
+    /* Names a basic block, which is the target of a branch. */
+    class label: public value {
+    public:
+        label(void)
+            : value()
+            {
+            }
+
+        virtual const std::string as_llvm(void) const { return "label"; }
+    };
+}
+
+#endif
@@ -144,16 +144,11 @@ namespace libcodegen {
                 std::string src0 = s0().llvm_name();
                 std::string src1 = s1().llvm_name();
 
-                char buffer[1024];
-                snprintf(buffer, 1024,
-                        "%s = %s %s %s, %s",
-                        dest.c_str(),
-                        opst.c_str(),
-                        type.c_str(),
-                        src0.c_str(),
-                        src1.c_str()
-                    );
-                return buffer;
+                /* Constants that are splatted across many lanes can
+                 * get very long, so these aren't built in a fixed
+                 * buffer. */
+                return dest + " = " + opst + " " + type + " "
+                    + src0 + ", " + src1;
             }
     };
 
@@ -206,16 +201,10 @@ namespace libcodegen {
                 std::string opst = op_llvm();
                 std::string type = s0().as_llvm();
                 std::string src0 = s0().llvm_name();
+                std::string ones = s0().constant_llvm("-1");
 
-                char buffer[1024];
-                snprintf(buffer, 1024,
-                        "%s = %s %s %s, -1",
-                        dest.c_str(),
-                        opst.c_str(),
-                        type.c_str(),
-                        src0.c_str()
-                    );
-                return buffer;
+                return dest + " = " + opst + " " + type + " "
+                    + src0 + ", " + ones;
             }
     };
     template<class T> not_op_cls<T>
@@ -22,6 +22,8 @@
 #ifndef LIBCODEGEN__OP_BITS_HXX
 #define LIBCODEGEN__OP_BITS_HXX
 
+#include "fix.h++"
+#include "function.h++"
 #include "operation.h++"
 
 /* These are all bit-casting operations, things like truncation and
@@ -52,16 +54,9 @@ namespace libcodegen {
                     return mov.as_llvm();
                 }
 
-                char buffer[1024];
-                snprintf(buffer, 1024,
-                         "%s = zext %s %s to %s",
-                         _o.llvm_name().c_str(),
-                         _i.as_llvm().c_str(),
-                         _i.llvm_name().c_str(),
-                         _o.as_llvm().c_str()
-                    );
-
-                return buffer;
+                return _o.llvm_name() + " = zext "
+                    + _i.as_llvm() + " " + _i.llvm_name()
+                    + " to " + _o.as_llvm();
             }
     };
     template<class O, class I>
@@ -90,9 +85,34 @@ namespace libcodegen {
                     return z.as_llvm();
                 }
 
+                return _o.llvm_name() + " = trunc "
+                    + _i.as_llvm() + " " + _i.llvm_name()
+                    + " to " + _o.as_llvm();
+            }
+    };
+    template<class O, class I>
+    zext_trunc_op_cls<O, I> zext_trunc_op(const O& o, const I& i)
+    { return zext_trunc_op_cls<O, I>(o, i); }
+
+    /* Reinterprets a value as another type of the same size, which is
+     * really only useful for casting between pointer types. */
+    template<class O, class I> class bitcast_op_cls: public operation {
+    private:
+        const O& _o;
+        const I& _i;
+
+    public:
+        bitcast_op_cls(const O& o, const I& i)
+            : _o(o),
+              _i(i)
+            {
+            }
+
+        virtual const std::string as_llvm(void) const
+            {
                 char buffer[1024];
                 snprintf(buffer, 1024,
-                         "%s = trunc %s %s to %s",
+                         "%s = bitcast %s %s to %s",
                          _o.llvm_name().c_str(),
                          _i.as_llvm().c_str(),
                          _i.llvm_name().c_str(),
@@ -103,8 +123,62 @@ namespace libcodegen {
             }
     };
     template<class O, class I>
-    zext_trunc_op_cls<O, I> zext_trunc_op(const O& o, const I& i)
-    { return zext_trunc_op_cls<O, I>(o, i); }
+    bitcast_op_cls<O, I> bitcast_op(const O& o, const I& i)
+    { return bitcast_op_cls<O, I>(o, i); }
+
+    /* LLVM's intrinsic that counts the leading zeros of a value.  It
+     * needs to be declared once for every type it's used with. */
+    class ctlz_func: public function_t {
+    private:
+        size_t _width;
+
+    public:
+        ctlz_func(size_t width)
+            : _width(width)
+            {
+            }
+
+        const std::string ret_llvm(void) const
+            { return fix_t(_width, "").as_llvm(); }
+
+        const std::string name(void) const
+            {
+                std::string elt = "i" + std::to_string(_width);
+                if (fix_t::lanes() <= 1)
+                    return "llvm.ctlz." + elt;
+                return "llvm.ctlz.v" + std::to_string(fix_t::lanes()) + elt;
+            }
+
+        const std::vector<std::string> args_llvm(void) const
+            { return {ret_llvm(), "i1"}; }
+    };
+
+    /* Counts the leading zeros of a value, which is defined to be the
+     * value's width when it's zero. */
+    template<class O, class I> class ctlz_op_cls: public operation {
+    private:
+        const O& _o;
+        const I& _i;
+
+    public:
+        ctlz_op_cls(const O& o, const I& i)
+            : _o(o),
+              _i(i)
+            {
+            }
+
+        virtual const std::string as_llvm(void) const
+            {
+                ctlz_func f(_i.width());
+                return _o.llvm_name() + " = call " + f.ret_llvm()
+                    + " @" + f.name() + "("
+                    + _i.as_llvm() + " " + _i.llvm_name()
+                    + ", i1 false)";
+            }
+    };
+    template<class O, class I>
+    ctlz_op_cls<O, I> ctlz_op(const O& o, const I& i)
+    { return ctlz_op_cls<O, I>(o, i); }
 }
 
 #endif
@@ -22,6 +22,9 @@
 #ifndef LIBCODEGEN__OP_COND_HXX
 #define LIBCODEGEN__OP_COND_HXX
 
+#include "label.h++"
+#include "operation.h++"
+
 /* Conditional operations: both conditional-move and branches. */
 namespace libcodegen {
     /* A special operation that supports Chisel's MUX operation. */
@@ -43,23 +46,77 @@ namespace libcodegen {
 
         virtual const std::string as_llvm(void) const
             {
-                char buffer[1024];
-                snprintf(buffer, 1024,
-                         "%s = select i1 %s, %s %s, %s %s",
-                         _d.llvm_name().c_str(),
-                         _s.llvm_name().c_str(),
-                         _t.as_llvm().c_str(),
-                         _t.llvm_name().c_str(),
-                         _f.as_llvm().c_str(),
-                         _f.llvm_name().c_str()
-                    );
-
-                return buffer;
+                return _d.llvm_name() + " = select "
+                    + _s.as_llvm() + " " + _s.llvm_name() + ", "
+                    + _t.as_llvm() + " " + _t.llvm_name() + ", "
+                    + _f.as_llvm() + " " + _f.llvm_name();
             }
     };
     template<class S, class V>
     mux_op_cls<S, V> mux_op(const V& d, const S& s, const V& t, const V& f)
     { return mux_op_cls<S, V>(d, s, t, f); }
+
+    /* Starts the basic block with the given name.  LLVM requires
+     * that the previous block ends with a branch. */
+    class label_op_cls: public operation {
+    private:
+        const label& _l;
+
+    public:
+        label_op_cls(const label& l)
+            : _l(l)
+            {
+            }
+
+        virtual const std::string as_llvm(void) const
+            { return _l.name() + ":"; }
+    };
+    inline label_op_cls label_op(const label& l)
+    { return label_op_cls(l); }
+
+    /* An unconditional branch. */
+    class br_op_cls: public operation {
+    private:
+        const label& _l;
+
+    public:
+        br_op_cls(const label& l)
+            : _l(l)
+            {
+            }
+
+        virtual const std::string as_llvm(void) const
+            { return "br label " + _l.llvm_name(); }
+    };
+    inline br_op_cls br_op(const label& l)
+    { return br_op_cls(l); }
+
+    /* A conditional branch, which goes to the first label when the
+     * condition is true and the second otherwise. */
+    template<class S> class condbr_op_cls: public operation {
+    private:
+        const S& _s;
+        const label& _t;
+        const label& _f;
+
+    public:
+        condbr_op_cls(const S& s, const label& t, const label& f)
+            : _s(s),
+              _t(t),
+              _f(f)
+            {
+            }
+
+        virtual const std::string as_llvm(void) const
+            {
+                return "br " + _s.as_llvm() + " " + _s.llvm_name()
+                    + ", label " + _t.llvm_name()
+                    + ", label " + _f.llvm_name();
+            }
+    };
+    template<class S>
+    condbr_op_cls<S> br_op(const S& s, const label& t, const label& f)
+    { return condbr_op_cls<S>(s, t, f); }
 }
 
 #endif
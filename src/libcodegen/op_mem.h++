@@ -22,6 +22,7 @@
 #ifndef LIBCODEGEN__OP_MEM_HXX
 #define LIBCODEGEN__OP_MEM_HXX
 
+#include "fix.h++"
 #include "operation.h++"
 
 /* These are all the sorts of operations that touch memory.  In
@@ -95,16 +96,20 @@ namespace libcodegen {
     index_op_cls<P, O> index_op(const P& dst, const P& src, const O& offset)
     { return index_op_cls<P, O>(dst, src, offset); }
 
-    /* Loads from memory. */
-    template<class T> class load_op_cls: public operation {
+    /* Loads from memory.  An alignment of 0 means the natural
+     * alignment of the loaded type. */
+    template<class T, class P = pointer<T> >
+    class load_op_cls: public operation {
     private:
         const T& _dst;
-        const pointer<T> &_src;
+        const P &_src;
+        size_t _align;
 
     public:
-        load_op_cls(const T& dst, const pointer<T>& src)
+        load_op_cls(const T& dst, const P& src, size_t align = 0)
             : _dst(dst),
-              _src(src)
+              _src(src),
+              _align(align)
             {
             }
 
@@ -118,23 +123,33 @@ namespace libcodegen {
                          _src.llvm_name().c_str()
                     );
 
-                return buffer;
+                if (_align == 0)
+                    return buffer;
+                return buffer + std::string(", align ") + std::to_string(_align);
             }
     };
     template<class T>
     load_op_cls<T> load_op(const T& dst, const pointer<T>& src)
     { return load_op_cls<T>(dst, src); }
+    inline
+    load_op_cls<fix_t, fix_ptr_t> load_op(const fix_t& dst,
+                                          const fix_ptr_t& src,
+                                          size_t align = 0)
+    { return load_op_cls<fix_t, fix_ptr_t>(dst, src, align); }
 
     /* Stores to memory. */
-    template<class T> class store_op_cls: public operation {
+    template<class T, class P = pointer<T> >
+    class store_op_cls: public operation {
     private:
-        const pointer<T>& _dst;
+        const P& _dst;
         const T &_src;
+        size_t _align;
 
     public:
-        store_op_cls(const pointer<T>& dst, const T& src)
+        store_op_cls(const P& dst, const T& src, size_t align = 0)
             : _dst(dst),
-              _src(src)
+              _src(src),
+              _align(align)
             {
             }
 
@@ -149,12 +164,19 @@ namespace libcodegen {
                          _dst.llvm_name().c_str()
                     );
 
-                return buffer;
+                if (_align == 0)
+                    return buffer;
+                return buffer + std::string(", align ") + std::to_string(_align);
             }
     };
     template<class T>
     store_op_cls<T> store_op(const pointer<T>& dst, const T& src)
     { return store_op_cls<T>(dst, src); }
+    inline
+    store_op_cls<fix_t, fix_ptr_t> store_op(const fix_ptr_t& dst,
+                                            const fix_t& src,
+                                            size_t align = 0)
+    { return store_op_cls<fix_t, fix_ptr_t>(dst, src, align); }
 }
 
 #endif
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of flo-llvm.
+ *
+ * flo-llvm is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * flo-llvm is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with flo-llvm.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef LIBCODEGEN__OP_VECTOR_HXX
+#define LIBCODEGEN__OP_VECTOR_HXX
+
+#include "operation.h++"
+#include <libflo/sizet_printf.h++>
+
+/* These operations move data between LLVM vectors and the scalars
+ * that make up their elements. */
+namespace libcodegen {
+    /* Inserts a scalar into one element of a vector.  When no source
+     * vector is provided then the other elements are undefined. */
+    template<class V, class E> class insertelement_op_cls: public operation {
+    private:
+        const V& _dst;
+        const V* _src;
+        const E& _elt;
+        size_t _index;
+
+    public:
+        insertelement_op_cls(const V& dst, const V* src, const E& elt,
+                             size_t index)
+            : _dst(dst),
+              _src(src),
+              _elt(elt),
+              _index(index)
+            {
+            }
+
+        virtual const std::string as_llvm(void) const
+            {
+                char buffer[1024];
+                snprintf(buffer, 1024,
+                         "%s = insertelement %s %s, %s %s, i32 " SIZET_FORMAT,
+                         _dst.llvm_name().c_str(),
+                         _dst.as_llvm().c_str(),
+                         _src == NULL ? "undef" : _src->llvm_name().c_str(),
+                         _elt.as_llvm().c_str(),
+                         _elt.llvm_name().c_str(),
+                         _index
+                    );
+                return buffer;
+            }
+    };
+    template<class V, class E>
+    insertelement_op_cls<V, E> insertelement_op(const V& dst, const E& elt,
+                                                size_t index)
+    { return insertelement_op_cls<V, E>(dst, NULL, elt, index); }
+    template<class V, class E>
+    insertelement_op_cls<V, E> insertelement_op(const V& dst, const V& src,
+                                                const E& elt, size_t index)
+    { return insertelement_op_cls<V, E>(dst, &src, elt, index); }
+
+    /* Extracts a single element from a vector as a scalar. */
+    template<class E, class V> class extractelement_op_cls: public operation {
+    private:
+        const E& _dst;
+        const V& _src;
+        size_t _index;
+
+    public:
+        extractelement_op_cls(const E& dst, const V& src, size_t index)
+            : _dst(dst),
+              _src(src),
+              _index(index)
+            {
+            }
+
+        virtual const std::string as_llvm(void) const
+            {
+                char buffer[1024];
+                snprintf(buffer, 1024,
+                         "%s = extractelement %s %s, i32 " SIZET_FORMAT,
+                         _dst.llvm_name().c_str(),
+                         _src.as_llvm().c_str(),
+                         _src.llvm_name().c_str(),
+                         _index
+                    );
+                return buffer;
+            }
+    };
+    template<class E, class V>
+    extractelement_op_cls<E, V> extractelement_op(const E& dst, const V& src,
+                                                  size_t index)
+    { return extractelement_op_cls<E, V>(dst, src, index); }
+
+    /* Copies the first element of a vector into every element of a
+     * new vector. */
+    template<class V> class broadcast_op_cls: public operation {
+    private:
+        const V& _dst;
+        const V& _src;
+        size_t _lanes;
+
+    public:
+        broadcast_op_cls(const V& dst, const V& src, size_t lanes)
+            : _dst(dst),
+              _src(src),
+              _lanes(lanes)
+            {
+            }
+
+        virtual const std::string as_llvm(void) const
+            {
+                char buffer[1024];
+                snprintf(buffer, 1024,
+                         "%s = shufflevector %s %s, %s undef, "
+                         "<" SIZET_FORMAT " x i32> zeroinitializer",
+                         _dst.llvm_name().c_str(),
+                         _src.as_llvm().c_str(),
+                         _src.llvm_name().c_str(),
+                         _src.as_llvm().c_str(),
+                         _lanes
+                    );
+                return buffer;
+            }
+    };
+    template<class V>
+    broadcast_op_cls<V> broadcast_op(const V& dst, const V& src, size_t lanes)
+    { return broadcast_op_cls<V>(dst, src, lanes); }
+}
+
+#endif
@@ -24,6 +24,7 @@
 using namespace libcodegen;
 
 static const std::string generate_unique_name(void);
+static long unsigned unique_index = 1;
 
 value::value(void)
     : _name(generate_unique_name())
@@ -35,17 +36,20 @@ value::value(const std::string name)
 {
 }
 
-const std::string generate_unique_name(void)
+void value::reset_unique_names(void)
 {
-    static long unsigned index = 1;
+    unique_index = 1;
+}
 
-    if (index == 0) {
+const std::string generate_unique_name(void)
+{
+    if (unique_index == 0) {
         fprintf(stderr, "Temporary value generated wrapped\n");
         abort();
     }
 
     char buffer[1024];
-    snprintf(buffer, 1024, "V%lu", index);
-    index++;
+    snprintf(buffer, 1024, "V%lu", unique_index);
+    unique_index++;
     return buffer;
 }
@@ -45,11 +45,17 @@ namespace libcodegen {
         /* Accessor functions. */
         const std::string name(void) const { return _name; }
 
+        /* Starts numbering temporary names from the beginning again.
+         * Temporaries only need to be unique within a function, so
+         * this can be done before starting a new one as long as no
+         * older temporaries are used inside it. */
+        static void reset_unique_names(void);
+
         /* Emits the LLVM name for this value's type. */
         virtual const std::string as_llvm(void) const = 0;
 
         /* Emits the LLVM name for this value. */
-        const std::string llvm_name(void) const
+        virtual const std::string llvm_name(void) const
             {
                 if (isdigit(name().c_str()[0]))
                     return name();
@@ -58,6 +64,11 @@ namespace libcodegen {
                 snprintf(buffer, 1024, "%%%s", name().c_str());
                 return buffer;
             }
+
+        /* Emits an LLVM constant of this value's type, given the
+         * literal that should be used for it. */
+        virtual const std::string constant_llvm(const std::string literal) const
+            { return literal; }
     };
 }
 
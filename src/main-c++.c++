@@ -19,9 +19,18 @@
  * <http://www.gnu.org/licenses/>.
  */
 
+#include "cones.h++"
 #include "flo.h++"
+#include "jit.h++"
 #include "node.h++"
 #include "operation.h++"
+#include "optimize.h++"
+#include "options.h++"
+#include "partitions.h++"
+#include "pool.h++"
+#include "state.h++"
+#include "timer.h++"
+#include "trace.h++"
 
 #include "version.h"
 
@@ -29,21 +38,27 @@
 #include <libcodegen/builtin.h++>
 #include <libcodegen/constant.h++>
 #include <libcodegen/fix.h++>
+#include <libcodegen/global.h++>
 #include <libcodegen/llvm.h++>
 #include <libcodegen/op_alu.h++>
 #include <libcodegen/op_bits.h++>
 #include <libcodegen/op_call.h++>
 #include <libcodegen/op_cond.h++>
 #include <libcodegen/op_mem.h++>
+#include <libcodegen/op_vector.h++>
 #include <libcodegen/pointer.h++>
 #include <libcodegen/vargs.h++>
 #include <libflo/sizet_printf.h++>
 #include <libflo/version.h++>
 
 #include <algorithm>
+#include <functional>
+#include <stdlib.h>
 #include <string.h>
 #include <string>
 #include <map>
+#include <set>
+#include <vector>
 
 using namespace libcodegen;
 
@@ -53,18 +68,210 @@ using namespace libcodegen;
 
 enum gentype {
     GENTYPE_IR,
+    GENTYPE_IR_SPLIT,
     GENTYPE_HEADER,
     GENTYPE_COMPAT,
     GENTYPE_HARNESS,
+    GENTYPE_JIT,
     GENTYPE_ERROR
 };
 
+/* Instrumented builds count the cycles that clock_lo spends on each
+ * of these classes of work, along with how many times each one was
+ * done.  Reading and writing are the accessor calls (or the loads and
+ * stores of a native state) that move nodes in and out of clock_lo. */
+enum profile_class {
+    PROFILE_LOGIC,
+    PROFILE_ARITH,
+    PROFILE_BITS,
+    PROFILE_MEM,
+    PROFILE_READ,
+    PROFILE_WRITE,
+    PROFILE_CLASSES
+};
+
 /* These generate the different sorts of files that can be produced by
  * the C++ toolchain. */
-static int generate_header(const flo_ptr flo, FILE *f);
-static int generate_compat(const flo_ptr flo, FILE *f);
-static int generate_llvmir(const flo_ptr flo, FILE *f);
-static int generate_harness(const flo_ptr flo, FILE *f);
+static int generate_header(const flo_ptr flo, const options& opts, FILE *f);
+static int generate_compat(const flo_ptr flo, const options& opts, FILE *f,
+                           bool in_header);
+static int generate_llvmir(const flo_ptr flo, const options& opts, FILE *f,
+                           bool split);
+static int generate_harness(const flo_ptr flo, const options& opts,
+                            FILE *f);
+
+/* Every function that makes up clock_lo has the same signature. */
+typedef function< builtin<void>,
+                  arglist2<pointer<builtin<void>>,
+                           builtin<bool>
+                           >
+                  > clock_lo_func;
+
+/* The cycle counter that --profile reads, and the accessor that finds
+ * the profile counters when the state isn't native. */
+typedef function<builtin<uint64_t>, arglist0> readcyclecounter_func;
+typedef function< pointer<builtin<uint64_t>>,
+                  arglist1<pointer<builtin<void>>>
+                  > profile_func;
+
+/* The arguments of every function that makes up clock_lo, along with
+ * the values that are derived from them at the start of each one. */
+class clock_lo_frame {
+public:
+    pointer<builtin<void>> dut;
+    builtin<bool> rst;
+    pointer<builtin<uint64_t>> state;
+    fix_t rst_lanes;
+
+    /* With --profile, the counters and every reading of the cycle
+     * counter so far (the last of which is where the next interval
+     * starts).  Consecutive operations of the same class share an
+     * interval, which is only charged to that class once it ends. */
+    pointer<builtin<uint64_t>> profile;
+    std::vector<builtin<uint64_t>> ticks;
+    enum profile_class pending_class;
+    size_t pending_ops;
+
+    /* The pieces of a split build find every field of the state
+     * through a global whose name starts with this (see
+     * state_offset()), and these are the globals they've used. */
+    std::string fields_prefix;
+    std::set<std::string> fields_used;
+
+public:
+    clock_lo_frame(void);
+};
+
+/* Declares the functions that the generated IR calls, which must be
+ * done at the start of every module.  Intrinsics are only declared
+ * when one of the given operations needs them. */
+static void generate_declarations(libcodegen::llvm& out,
+                                  const flo_ptr flo,
+                                  const options& opts,
+                                  const std::vector<std::shared_ptr< ::operation>>& ops);
+
+/* Lays out the state of a design, including whatever extra fields
+ * are needed by the way clock_lo is split up. */
+static state_layout layout_state(const flo_ptr flo, const options& opts);
+
+/* Emits a single function that computes part of clock_lo: it loads
+ * everything that's computed elsewhere from the state, computes its
+ * operations (storing those that are used elsewhere), and finally
+ * stores the next value of some registers.  Pieces that go in modules
+ * of their own don't bake in where anything is in the state. */
+static void generate_piece(libcodegen::llvm& out,
+                           FILE *f,
+                           const flo_ptr flo,
+                           const std::string name,
+                           const std::vector<std::shared_ptr<node>>& imports,
+                           const std::vector<std::shared_ptr< ::operation>>& ops,
+                           const std::vector<std::shared_ptr< ::operation>>& nexts,
+                           const std::vector<std::shared_ptr<node>>& stored,
+                           const options& opts,
+                           const state_layout& layout,
+                           bool split);
+
+/* Returns the offset of a word in the native state.  That's just a
+ * constant, except in the pieces of a split build: those load where
+ * the word's field starts from a global that's defined by the link
+ * module, so their IR doesn't change when an edit elsewhere in the
+ * design moves fields around. */
+static builtin<uint64_t> state_offset(std::shared_ptr<definition> lo,
+                                      const state_layout& layout,
+                                      clock_lo_frame& frame,
+                                      size_t offset);
+
+/* The prefix of the globals that hold where each field starts. */
+static std::string fields_prefix(const flo_ptr flo);
+
+/* Emits a clock_lo that only calls the function for each cone of
+ * logic when one of its triggers has changed since the last cycle. */
+static void generate_activity(libcodegen::llvm& out,
+                              FILE *f,
+                              const flo_ptr flo,
+                              const options& opts,
+                              const state_layout& layout);
+
+/* Emits an arithmetic operation on wide nodes in 64 bits, which is
+ * only possible when the optimization passes found that its operands
+ * and result all fit in a word.  Returns FALSE if that's not the
+ * case, in which case nothing is emitted. */
+static bool generate_narrow(std::shared_ptr<definition> lo,
+                            const std::shared_ptr< ::operation> op);
+
+/* Emits the parts of clock_lo that are specific to the code generated
+ * for a single operation, the start of every function, and the end of
+ * a cycle for a single register. */
+static void generate_op(std::shared_ptr<definition> lo,
+                        const std::shared_ptr< ::operation> op,
+                        const options& opts,
+                        const state_layout& layout,
+                        bool writeback,
+                        clock_lo_frame& frame);
+static void generate_prologue(std::shared_ptr<definition> lo,
+                              const flo_ptr flo,
+                              const options& opts,
+                              const state_layout& layout,
+                              clock_lo_frame& frame);
+static void generate_next(std::shared_ptr<definition> lo,
+                          const std::shared_ptr< ::operation> op,
+                          const options& opts,
+                          const state_layout& layout,
+                          clock_lo_frame& frame);
+
+/* Charges an operation to a class of work when building with
+ * --profile, which must be done before the operation's code is emitted
+ * so that it lands in the class's interval.  The cycle counter is only
+ * read when the class changes, and once more (by the flush) right
+ * before the function returns. */
+static void generate_profile(std::shared_ptr<definition> lo,
+                             const options& opts,
+                             clock_lo_frame& frame,
+                             enum profile_class c);
+static void generate_profile_flush(std::shared_ptr<definition> lo,
+                                   const options& opts,
+                                   clock_lo_frame& frame);
+
+/* Returns the class of work that an operation is charged to, and the
+ * name that class is reported with. */
+static enum profile_class profile_class_of(libflo::opcode op);
+static const char *profile_class_name(enum profile_class c);
+
+/* Simulating more than one lane at a time doesn't fit into Chisel's
+ * interface (which only has a single value for every node), so there's
+ * an entirely different header and compatibility layer. */
+static int generate_lanes_header(const flo_ptr flo, const options& opts,
+                                 FILE *f);
+static int generate_lanes_compat(const flo_ptr flo, const options& opts,
+                                 FILE *f, bool in_header);
+
+/* When clock_lo is split into partitions they're run by a pool of
+ * threads, which is a C++ class that's emitted into the header so
+ * every instance of the design can own one. */
+static void generate_pool(const flo_ptr flo, const partitions& parts,
+                          FILE *f);
+
+/* The VCD header lists every signal along with the module hierarchy,
+ * which doesn't change from cycle to cycle. */
+static std::string vcd_header(const flo_ptr flo);
+
+/* Quotes a string so it can be emitted as a C string literal. */
+static std::string c_literal(const std::string str);
+
+/* Returns the size of the buffer dump() formats each cycle into, which
+ * is big enough to hold every signal. */
+static size_t dump_buffer_size(const flo_ptr flo, const options& opts);
+
+/* Emits dump(), which writes out either a VCD file or the binary
+ * trace that's described in trace.h++. */
+static void generate_dump(const flo_ptr flo, const options& opts, FILE *f,
+                          bool in_header);
+
+/* Generates everything above from a single parse of the Flo file and
+ * builds it inside this process, either writing out the object and
+ * header files or running the design directly. */
+static int generate_jit(const flo_ptr flo, const options& opts,
+                        const std::string prefix, timer& t);
 
 /* Returns TRUE if the haystack starts with the needle. */
 static bool strsta(const std::string haystack, const std::string needle);
@@ -80,6 +287,84 @@ static void int2array(std::shared_ptr<definition> lo,
                       pointer<builtin<uint64_t>> pointer,
                       size_t words);
 
+/* Loads and stores a node from the flat state structure that's used
+ * when flo-llvm owns the layout of the design's state.  When there's
+ * more than one lane every word is really a vector of words. */
+static void load_state(std::shared_ptr<definition> lo,
+                       fix_t out,
+                       clock_lo_frame& frame,
+                       const state_layout& layout,
+                       size_t offset,
+                       size_t words,
+                       size_t lanes);
+static void store_state(std::shared_ptr<definition> lo,
+                        fix_t in,
+                        clock_lo_frame& frame,
+                        const state_layout& layout,
+                        size_t offset,
+                        size_t words,
+                        size_t lanes);
+
+/* Converts between a vector with one element per lane and the
+ * vectors of 64-bit words that it's stored as. */
+static void words2vec(std::shared_ptr<definition> lo,
+                      fix_t out,
+                      const std::vector<fix_t>& words);
+static std::vector<fix_t> vec2words(std::shared_ptr<definition> lo,
+                                    fix_t in,
+                                    size_t words);
+
+/* Reads and writes a memory that lives in a single-lane native state,
+ * which is just an indexed load and a conditional store. */
+static void mem_read(std::shared_ptr<definition> lo,
+                     fix_t out,
+                     clock_lo_frame& frame,
+                     const state_layout& layout,
+                     const std::shared_ptr<node> mem,
+                     fix_t index);
+static void mem_write(std::shared_ptr<definition> lo,
+                      clock_lo_frame& frame,
+                      const state_layout& layout,
+                      const std::shared_ptr<node> mem,
+                      fix_t enable,
+                      fix_t index,
+                      fix_t in);
+
+/* Reads and writes a memory in a multi-lane state, where every lane
+ * can access a different element. */
+static void mem_read_lanes(std::shared_ptr<definition> lo,
+                           fix_t out,
+                           clock_lo_frame& frame,
+                           const state_layout& layout,
+                           const std::shared_ptr<node> mem,
+                           fix_t index);
+static void mem_write_lanes(std::shared_ptr<definition> lo,
+                            clock_lo_frame& frame,
+                            const state_layout& layout,
+                            const std::shared_ptr<node> mem,
+                            fix_t enable,
+                            fix_t index,
+                            fix_t in);
+
+/* Collects the contents that INIT operations give to each memory, as
+ * a list of (index, words) pairs.  Indices that mem_t::put() would
+ * ignore are dropped here. */
+typedef std::vector<std::pair<size_t, std::vector<uint64_t>>> mem_init_t;
+static std::map<std::string, mem_init_t> mem_inits(const flo_ptr flo);
+
+/* Emits the INIT contents of every memory as a constant table, along
+ * with a loop that copies it into the state.  This is much faster to
+ * compile than a call for every element. */
+static void generate_mem_init(const flo_ptr flo, bool lanes, FILE *f);
+
+/* Parses a (decimal or hex) constant's name into 64-bit words. */
+static std::vector<uint64_t> constant_words(const std::string str,
+                                            size_t words);
+
+/* Returns a constant of the given width.  Constants are splatted
+ * across every lane, so they're kept as a fix_t. */
+static fix_t fix_constant(size_t width, uint64_t value);
+
 /* Counts the number of module components in a list. */
 static size_t count_components(const std::string str);
 
@@ -92,16 +377,17 @@ int main(int argc, const char **argv)
 {
     /* Prints the version if it was asked for. */
     if (argc == 2 && strcmp(argv[1], "--version") == 0) {
-        fprintf(stderr, "%s (using libflo %s)\n",
+        fprintf(stderr, "%s (using libflo %s%s)\n",
                 PCONFIGURE_VERSION,
-                libflo::version());
+                libflo::version(),
+                jit::supported() ? "" : ", without --jit");
         exit(0);
     }
 
     /* Prints the help text if it was asked for or if there was no
      * input file given. */
-    if (argc == 1 || argc > 3 || strcmp(argv[1], "--help") == 0) {
-        fprintf(stderr, "%s: <flo> <type>\n", argv[0]);
+    if (argc < 3 || strcmp(argv[1], "--help") == 0) {
+        fprintf(stderr, "%s: <flo> <type> [options...]\n", argv[0]);
         fprintf(stderr, "  Converts a Flo file to LLVM IR\n");
         fprintf(stderr, "  The output will be a drop-in replacement for\n");
         fprintf(stderr, "  Chisel's C++ emulator\n");
@@ -116,33 +402,117 @@ int main(int argc, const char **argv)
     enum gentype type = GENTYPE_ERROR;
     if (strcmp(argv[2], "--ir") == 0)
         type = GENTYPE_IR;
+    if (strcmp(argv[2], "--ir-split") == 0)
+        type = GENTYPE_IR_SPLIT;
     if (strcmp(argv[2], "--header") == 0)
         type = GENTYPE_HEADER;
     if (strcmp(argv[2], "--compat") == 0)
         type = GENTYPE_COMPAT;
     if (strcmp(argv[2], "--harness") == 0)
         type = GENTYPE_HARNESS;
+    if (strcmp(argv[2], "--jit") == 0)
+        type = GENTYPE_JIT;
+
+    /* Everything after the type is an option that controls how code
+     * gets generated. */
+    options opts;
+    for (int i = 3; i < argc; ++i) {
+        if (opts.parse(argv[i]) == false) {
+            fprintf(stderr, "Unknown option '%s'\n", argv[i]);
+            options::usage(stderr);
+            exit(1);
+        }
+    }
+
+    /* Deciding whether a cone has changed is done for all lanes at
+     * once and can't be split between threads or chunks. */
+    if (opts.activity() == true
+        && (opts.lanes() > 1 || opts.threads() > 1 || opts.chunk() > 0)) {
+        fprintf(stderr, "--activity can't be used with --lanes, --threads or --chunk\n");
+        exit(1);
+    }
+
+    /* The profile is a single set of counters for the whole design,
+     * which threads would race on and lanes don't have a way to dump. */
+    if (opts.profile() == true && (opts.lanes() > 1 || opts.threads() > 1)) {
+        fprintf(stderr, "--profile can't be used with --lanes or --threads\n");
+        exit(1);
+    }
+
+    /* The harness drives Chisel's single-lane interface, which the
+     * lanes header doesn't have. */
+    if (type == GENTYPE_HARNESS && opts.lanes() > 1) {
+        fprintf(stderr, "--harness can't be used with --lanes\n");
+        exit(1);
+    }
+
+    /* Building in-process needs LLVM, which isn't always there. */
+    if (type == GENTYPE_JIT && jit::supported() == false) {
+        fprintf(stderr, "--jit requires flo-llvm to be built against LLVM\n");
+        exit(1);
+    }
+
+    /* Running in-process means there's no C++ to provide the state,
+     * so flo-llvm needs to own it and everything must be accessible
+     * from the generated code. */
+    if (opts.cycles() > 0 && opts.native_state() == false) {
+        fprintf(stderr, "--cycles requires --native-state\n");
+        exit(1);
+    }
 
     /* Reads the input file and infers the width of every node. */
-    auto flo = flo::parse(infn);
+    timer t;
+    flo_ptr flo = flo::parse(infn);
+    t.phase("parse");
+
+    /* The optimized graph replaces the original for everything, as
+     * the header, compat layer and IR all need to agree on it.  A
+     * build generates all of those, but only reports the passes
+     * once: when it generates the IR. */
+    if (opts.optimize() == true) {
+        optimizer o(flo);
+        flo = o.result();
+        t.phase("flo-optimize");
+
+        bool ir = (type == GENTYPE_IR || type == GENTYPE_IR_SPLIT
+                   || type == GENTYPE_JIT);
+        if (opts.pass_stats() == true && ir == true)
+            o.report(stderr);
+    }
 
     /* Figures out what sort of output to generate. */
     switch (type) {
     case GENTYPE_IR:
-        return generate_llvmir(flo, stdout);
+        return generate_llvmir(flo, opts, stdout, false);
+    case GENTYPE_IR_SPLIT:
+        return generate_llvmir(flo, opts, stdout, true);
     case GENTYPE_HEADER:
-        return generate_header(flo, stdout);
+        return generate_header(flo, opts, stdout);
     case GENTYPE_COMPAT:
-        return generate_compat(flo, stdout);
+        return generate_compat(flo, opts, stdout, false);
     case GENTYPE_HARNESS:
-        return generate_harness(flo, stdout);
+        return generate_harness(flo, opts, stdout);
+    case GENTYPE_JIT:
+    {
+        /* The outputs go right next to the input, just like the
+         * wrapper script does it. */
+        std::string prefix = argv[1];
+        if (strcmp(argv[1], "-") == 0)
+            prefix = flo->class_name();
+        if (prefix.size() > 4 && strcmp(prefix.c_str() + prefix.size() - 4, ".flo") == 0)
+            prefix = prefix.substr(0, prefix.size() - 4);
+
+        return generate_jit(flo, opts, prefix, t);
+    }
     case GENTYPE_ERROR:
         fprintf(stderr, "Unknown generate target '%s'\n", argv[2]);
         fprintf(stderr, "  valid targets are:\n");
         fprintf(stderr, "    --ir:     Generates LLVM IR\n");
+        fprintf(stderr, "    --ir-split: Generates LLVM IR as many modules\n");
         fprintf(stderr, "    --header: Generates a C++ class header\n");
         fprintf(stderr, "    --compat: Generates a C++ compat layer\n");
         fprintf(stderr, "    --harness:Generates a C++ test harness\n");
+        fprintf(stderr, "    --jit:    Builds a .o and .h in-process\n");
         abort();
         return 1;
     }
@@ -150,8 +520,13 @@ int main(int argc, const char **argv)
     return 0;
 }
 
-int generate_header(const flo_ptr flo, FILE *f)
+int generate_header(const flo_ptr flo, const options& opts, FILE *f)
 {
+    if (opts.lanes() > 1)
+        return generate_lanes_header(flo, opts, f);
+
+    partitions parts(flo, opts.threads(), opts.chunk());
+
     /* Figures out the class name, printing that out. */
     fprintf(f, "#include <stdio.h>\n");
     fprintf(f, "#include <stdint.h>\n");
@@ -159,7 +534,52 @@ int generate_header(const flo_ptr flo, FILE *f)
      * defeats the point of doing all this in the first
      * place... */
     fprintf(f, "#include \"emulator.h\"\n");
-    fprintf(f, "class %s_t: public mod_t {\n", flo->class_name().c_str());
+
+    /* When flo-llvm owns the state it's described by a flat structure
+     * that the generated code indexes directly.  The Chisel class
+     * then just inherits from that structure, which means all the
+     * dat_t/mem_t names continue to work as they did before. */
+    if (opts.native_state() == true) {
+        auto layout = layout_state(flo, opts);
+
+        fprintf(f, "#include <stddef.h>\n");
+        fprintf(f, "#include <string.h>\n");
+
+        fprintf(f, "struct alignas(" SIZET_FORMAT ") %s_state_t {\n",
+                state_layout::line_words * sizeof(uint64_t),
+                flo->class_name().c_str());
+
+        for (const auto& field: layout.fields()) {
+            auto node = field.n();
+
+            if (node == NULL) {
+                fprintf(f, "    uint64_t %s[" SIZET_FORMAT "];\n",
+                        field.name().c_str(),
+                        field.words());
+            } else if (node->is_mem() == true) {
+                fprintf(f, "    mem_t<" SIZET_FORMAT ", " SIZET_FORMAT "> %s;\n",
+                        node->width(),
+                        node->depth(),
+                        node->mangled_name().c_str());
+            } else {
+                fprintf(f, "    dat_t<" SIZET_FORMAT "> %s;\n",
+                        node->width(),
+                        field.name().c_str());
+            }
+        }
+
+        fprintf(f, "};\n");
+
+        if (parts.threads() > 1)
+            generate_pool(flo, parts, f);
+
+        fprintf(f, "class %s_t: public mod_t, public %s_state_t {\n",
+                flo->class_name().c_str(),
+                flo->class_name().c_str());
+    } else {
+        fprintf(f, "class %s_t: public mod_t {\n",
+                flo->class_name().c_str());
+    }
     fprintf(f, "  public:\n");
 
     /* Declares the variables that need to be present in the C++
@@ -170,14 +590,18 @@ int generate_header(const flo_ptr flo, FILE *f)
             continue;
 
         if (node->is_mem() == true) {
-            fprintf(f, "    mem_t<" SIZET_FORMAT ", " SIZET_FORMAT "> %s;\n",
-                    node->width(),
-                    node->depth(),
-                    node->mangled_name().c_str());
+            if (opts.native_state() == false) {
+                fprintf(f, "    mem_t<" SIZET_FORMAT ", " SIZET_FORMAT "> %s;\n",
+                        node->width(),
+                        node->depth(),
+                        node->mangled_name().c_str());
+            }
         } else {
-            fprintf(f, "    dat_t<" SIZET_FORMAT "> %s;\n",
-                    node->width(),
-                    node->mangled_name().c_str());
+            if (opts.native_state() == false) {
+                fprintf(f, "    dat_t<" SIZET_FORMAT "> %s;\n",
+                        node->width(),
+                        node->mangled_name().c_str());
+            }
 
             fprintf(f, "    dat_t<" SIZET_FORMAT "> %s__prev;\n",
                     node->width(),
@@ -198,6 +622,32 @@ int generate_header(const flo_ptr flo, FILE *f)
     fprintf(f, "    mod_t *clone(void);\n");
     fprintf(f, "    bool set_circuit_from(mod_t *src);\n");
 
+    /* This isn't part of Chisel's interface, it reports how often
+     * each cone of logic was actually evaluated. */
+    if (opts.activity() == true)
+        fprintf(f, "    void dump_activity(FILE *f);\n");
+
+    /* Likewise, this reports where clock_lo spent its time.  Native
+     * states already have space for the counters. */
+    if (opts.profile() == true) {
+        if (opts.native_state() == false)
+            fprintf(f, "    uint64_t __profile[%d];\n", 2 * PROFILE_CLASSES);
+        fprintf(f, "    void dump_profile(FILE *f);\n");
+    }
+
+    /* The binary trace needs to know when to write a keyframe. */
+    if (opts.binary_trace() == true)
+        fprintf(f, "    unsigned long __trace_records;\n");
+
+    /* Each instance formats its own dump, so they can be dumped from
+     * different threads. */
+    fprintf(f, "    char __dump_buffer[" SIZET_FORMAT "];\n",
+            dump_buffer_size(flo, opts));
+
+    /* Partitioned designs are run by their own threads. */
+    if (parts.threads() > 1)
+        fprintf(f, "    _llvmflo_%s_pool __pool;\n", flo->class_name().c_str());
+
     /* Close the class */
     fprintf(f, "};\n");
 
@@ -211,8 +661,50 @@ int generate_header(const flo_ptr flo, FILE *f)
     return 0;
 }
 
-int generate_compat(const flo_ptr flo, FILE *f)
+int generate_compat(const flo_ptr flo, const options& opts, FILE *f,
+                    bool in_header)
 {
+    if (opts.lanes() > 1)
+        return generate_lanes_compat(flo, opts, f, in_header);
+
+    /* A compatibility layer that's part of a header can be included
+     * by more than one C++ file, so everything it defines has to be
+     * inline.  The accessors are only called by the generated code,
+     * so they need to be emitted anyway. */
+    const char *inl = in_header ? "inline " : "";
+    const char *acc = in_header ? "inline __attribute__((used)) " : "";
+
+    partitions parts(flo, opts.threads(), opts.chunk());
+    auto layout = layout_state(flo, opts);
+
+    /* The generated code indexes directly into the state structure,
+     * so make sure the C++ compiler agrees with the layout that was
+     * used when generating it. */
+    if (opts.native_state() == true) {
+        fprintf(f, "#pragma GCC diagnostic push\n");
+        fprintf(f, "#pragma GCC diagnostic ignored \"-Winvalid-offsetof\"\n");
+
+        for (const auto& field: layout.fields()) {
+            if (field.n() == NULL)
+                continue;
+
+            fprintf(f, "static_assert(offsetof(%s_state_t, %s) == " SIZET_FORMAT ", \"state layout mismatch\");\n",
+                    flo->class_name().c_str(),
+                    field.name().c_str(),
+                    field.offset() * sizeof(uint64_t));
+        }
+
+        fprintf(f, "static_assert(sizeof(%s_state_t) == " SIZET_FORMAT ", \"state layout mismatch\");\n",
+                flo->class_name().c_str(),
+                layout.words() * sizeof(uint64_t));
+
+        fprintf(f, "#pragma GCC diagnostic pop\n");
+    }
+
+    /* When the state is native the generated code is only ever handed
+     * the state structure, not the whole class. */
+    auto dut_type = flo->class_name() + (opts.native_state() ? "_state_t" : "_t");
+
     /* The whole point of this is to work around the C++ name
      * mangling. */
     fprintf(f, "extern \"C\" {\n");
@@ -225,13 +717,16 @@ int generate_compat(const flo_ptr flo, FILE *f)
         if (node->exported() == false)
             continue;
 
-        if (node->is_mem() == true) {
+        if (node->is_mem() == true && opts.native_state() == true) {
+            /* The generated code indexes native memories itself. */
+        } else if (node->is_mem() == true) {
             /* This function pulls the value from a node into an
              * array.  Essentially this just does C++ name
              * demangling. */
-            fprintf(f, "  void _llvmflo_%s_getm(%s_t *d, uint64_t i, uint64_t *a) {\n",
+            fprintf(f, "  %svoid _llvmflo_%s_getm(%s *d, uint64_t i, uint64_t *a) {\n",
+                    acc,
                     node->mangled_name().c_str(),
-                    flo->class_name().c_str()
+                    dut_type.c_str()
                 );
 
             fprintf(f, "    dat_t<" SIZET_FORMAT "> v = d->%s.get(i);\n",
@@ -250,9 +745,10 @@ int generate_compat(const flo_ptr flo, FILE *f)
             fprintf(f, "  }\n");
 
             /* The opposite of the above: sets a mem_t value. */
-            fprintf(f, "  void _llvmflo_%s_setm(%s_t *d, uint64_t i, uint64_t *a) {\n",
+            fprintf(f, "  %svoid _llvmflo_%s_setm(%s *d, uint64_t i, uint64_t *a) {\n",
+                    acc,
                     node->mangled_name().c_str(),
-                    flo->class_name().c_str()
+                    dut_type.c_str()
                 );
 
             fprintf(f, "    dat_t<" SIZET_FORMAT "> v;",
@@ -272,11 +768,12 @@ int generate_compat(const flo_ptr flo, FILE *f)
                 );
 
             fprintf(f, "  }\n");
-        } else {
+        } else if (opts.native_state() == false) {
             /* This function pulls the value from a node into an
              * array.  Essentially this just does C++ name
              * demangling. */
-            fprintf(f, "  void _llvmflo_%s_get(%s_t *d, uint64_t *a) {\n",
+            fprintf(f, "  %svoid _llvmflo_%s_get(%s_t *d, uint64_t *a) {\n",
+                    acc,
                     node->mangled_name().c_str(),
                     flo->class_name().c_str()
                 );
@@ -293,7 +790,8 @@ int generate_compat(const flo_ptr flo, FILE *f)
             fprintf(f, "  }\n");
 
             /* The opposite of the above: sets a dat_t value. */
-            fprintf(f, "  void _llvmflo_%s_set(%s_t *d, uint64_t *a) {\n",
+            fprintf(f, "  %svoid _llvmflo_%s_set(%s_t *d, uint64_t *a) {\n",
+                    acc,
                     node->mangled_name().c_str(),
                     flo->class_name().c_str()
                 );
@@ -311,6 +809,15 @@ int generate_compat(const flo_ptr flo, FILE *f)
         }
     }
 
+    /* Without a native state the generated code can only find the
+     * profile counters through the class. */
+    if (opts.profile() == true && opts.native_state() == false) {
+        fprintf(f, "  %suint64_t *_llvmflo_%s_profile(%s_t *d) { return d->__profile; }\n",
+                acc,
+                flo->class_name().c_str(),
+                flo->class_name().c_str());
+    }
+
     /* Here's where we elide the last bits of name mangling: these
      * functions wrap some non-mangled IR-generated names that
      * actually implement the functions required by Chisel's C++
@@ -318,8 +825,8 @@ int generate_compat(const flo_ptr flo, FILE *f)
     fprintf(f, "  void _llvmflo_%s_init(%s_t *p, bool r);\n",
             flo->class_name().c_str(), flo->class_name().c_str());
 
-    fprintf(f, "  void _llvmflo_%s_clock_lo(%s_t *p, bool r);\n",
-            flo->class_name().c_str(), flo->class_name().c_str());
+    fprintf(f, "  void _llvmflo_%s_clock_lo(%s *p, bool r);\n",
+            flo->class_name().c_str(), dut_type.c_str());
 
     fprintf(f, "  void _llvmflo_%s_clock_hi(%s_t *p, bool r);\n",
             flo->class_name().c_str(), flo->class_name().c_str());
@@ -328,20 +835,43 @@ int generate_compat(const flo_ptr flo, FILE *f)
     fprintf(f, "};\n");
 
     /* The clock function just calls the other two clock functions. */
-    fprintf(f, "int %s_t::clock(dat_t<1> rd)\n", flo->class_name().c_str());
+    fprintf(f, "%sint %s_t::clock(dat_t<1> rd)\n", inl, flo->class_name().c_str());
     fprintf(f, "  { clock_lo(rd); clock_hi(rd); return 0; }\n");
 
     /* Actually define the (non mangled) implementation of the Chisel
      * C++ interface, which in fact only calls the LLVM-generated
      * functions. */
-    fprintf(f, "void %s_t::clock_lo(dat_t<1> rd)\n",
-            flo->class_name().c_str());
-    fprintf(f, "  { _llvmflo_%s_clock_lo(this, rd.to_ulong()); }\n",
-            flo->class_name().c_str());
+    fprintf(f, "%svoid %s_t::clock_lo(dat_t<1> rd)\n",
+            inl, flo->class_name().c_str());
+    if (parts.threads() > 1) {
+        fprintf(f, "  { __pool.clock_lo(this, rd.to_ulong()); }\n");
+    } else {
+        fprintf(f, "  { _llvmflo_%s_clock_lo(this, rd.to_ulong()); }\n",
+                flo->class_name().c_str());
+    }
 
     /* init just sets everything to zero, which is easy to do in C++
      * (it'll be fairly short). */
-    fprintf(f, "void %s_t::init(bool r)\n{\n", flo->class_name().c_str());
+    fprintf(f, "%svoid %s_t::init(bool r)\n{\n", inl, flo->class_name().c_str());
+    for (const auto& field: layout.fields()) {
+        if (opts.native_state() == false)
+            break;
+
+        if (field.n() == NULL || field.next() == false)
+            continue;
+
+        fprintf(f, "  this->%s__next = 0;\n",
+                field.n()->mangled_name().c_str());
+    }
+    if (opts.activity() == true) {
+        fprintf(f, "  memset(this->__activity, 0, sizeof(this->__activity));\n");
+        fprintf(f, "  this->__activity_cycles[0] = 0;\n");
+        fprintf(f, "  this->__activity_full[0] = 1;\n");
+    }
+    if (opts.binary_trace() == true)
+        fprintf(f, "  this->__trace_records = 0;\n");
+    if (opts.profile() == true)
+        fprintf(f, "  memset(this->__profile, 0, sizeof(this->__profile));\n");
     for (const auto& node: flo->nodes()) {
         if (node->exported() == false)
             continue;
@@ -359,25 +889,31 @@ int generate_compat(const flo_ptr flo, FILE *f)
         }
     }
 
-    for (const auto& op: flo->operations()) {
-        if (op->op() != libflo::opcode::INIT)
-            continue;
-
-        fprintf(f, "  this->%s.put(%s, %s);\n",
-                op->s()->mangled_name().c_str(),
-                op->t()->name().c_str(),
-                op->u()->name().c_str()
-            );
-    }
+    generate_mem_init(flo, false, f);
     fprintf(f, "}\n");
 
     /* clock_hi just copies data around and therefor is simplest to
      * stick in C++ -- using LLVM IR doesn't really gain us anything
      * here. */
-    fprintf(f, "void %s_t::clock_hi(dat_t<1> rd)\n{\n",
-            flo->class_name().c_str());
+    fprintf(f, "%svoid %s_t::clock_hi(dat_t<1> rd)\n{\n",
+            inl, flo->class_name().c_str());
     fprintf(f, "  bool r = rd.to_ulong();\n");
+
+    /* The next value of every register has already been stored by
+     * clock_lo, so all that's left is a single copy.  The shadows are
+     * exactly the same types in exactly the same order as the
+     * registers, so this even copies identical dat_t headers. */
+    if (opts.native_state() == true && layout.regs_words() > 0) {
+        fprintf(f, "  %s *s = this;\n", dut_type.c_str());
+        fprintf(f, "  memcpy((uint64_t *)s, (uint64_t *)s + " SIZET_FORMAT ", " SIZET_FORMAT ");\n",
+                layout.nexts_offset(),
+                layout.regs_words() * sizeof(uint64_t));
+    }
+
     for (const auto& op: flo->operations()) {
+        if (opts.native_state() == true)
+            break;
+
         /* Only registers need to be copied on */
         if (op->op() != libflo::opcode::REG)
             continue;
@@ -391,179 +927,12 @@ int generate_compat(const flo_ptr flo, FILE *f)
 
     /* VCD dumping is implemented directly in C++ here because I don't
      * really see a reason not to. */
-    fprintf(f, "void %s_t::dump(FILE *f, int cycle)\n{\n",
-            flo->class_name().c_str());
-
-    /* On the first cycle we need to write out the VCD header file. */
-    fprintf(f, "  if (cycle == 0) {\n");
-    fprintf(f, "    fprintf(f, \"$timescale 1ps $end\\n\");\n");
-    fprintf(f, "    fprintf(f, \"$scope module %s $end\\n\");\n",
-            flo->class_name().c_str());
-
-    std::string last_path = "";
-    ssize_t scope = 1;
-    for (const auto& node: flo->nodes_alpha()) {
-        char buffer[BUFFER_SIZE];
-        snprintf(buffer, BUFFER_SIZE, "%s", node->name().c_str());
-
-        /* Here's where we figure out where in the module heirarchy
-         * this node is. */
-        char *module = buffer;
-        char *signal = buffer;
-        for (size_t i = 0; i < strlen(buffer); i++)
-            if (buffer[i] == ':')
-                signal = buffer + i;
-
-        /* These have no "::" in them, which means they're not
-         * globally visible. */
-        if (module == signal)
-            continue;
-
-        /* The module seperator can be either ":" or "::".  Detect
-         * which one is actually generated and demangle the name
-         * correctly. */
-        if (signal[-1] == ':')
-            signal[-1] = '\0';
-        signal[0] = '\0';
-        signal++;
-
-        /* Figure out if we're going up or down a module and perform
-         * that move. */
-        if (strcmp(module, last_path.c_str()) == 0) {
-        } else if (component_start(last_path, module)) {
-            fprintf(f, "    fprintf(f, \"$upscope $end\\n\");\n");
-            scope--;
-        } else if (component_start(module, last_path)) {
-            /* Determine a slightly shorter name for the module, which
-             * is what VCD uses.  This is just the last component of
-             * the module name, the remainder can be determined by the
-             * hierarchy. */
-            char *lastmodule = module;
-            for (size_t i = 0; i < strlen(module); i++)
-                if (module[i] == ':')
-                    lastmodule = module + i;
-            if (*lastmodule == ':')
-                lastmodule++;
-
-            fprintf(f, "    fprintf(f, \"$scope module %s $end\\n\");\n",
-                    lastmodule);
-            scope++;
-        } else {
-            size_t cur_comp  = count_components(node->name());
-            size_t last_comp = count_components(last_path) + 1;
-            for (size_t i = cur_comp; i <= last_comp; ++i) {
-                fprintf(f, "    fprintf(f, \"$upscope $end\\n\");\n");
-                scope--;
-            }
-
-            /* Determine a slightly shorter name for the module, which
-             * is what VCD uses.  This is just the last component of
-             * the module name, the remainder can be determined by the
-             * hierarchy. */
-            char *lastmodule = module;
-            for (size_t i = 0; i < strlen(module); i++)
-                if (module[i] == ':')
-                    lastmodule = module + i;
-            if (*lastmodule == ':')
-                lastmodule++;
-
-            fprintf(f, "    fprintf(f, \"$scope module %s $end\\n\");\n",
-                    lastmodule);
-            scope++;
-        }
-
-        /* After changing modules, go ahead and output the wire. */
-        fprintf(f, "    fprintf(f, \"$var wire " SIZET_FORMAT " %s %s $end\\n\");\n",
-                node->width(),
-                node->vcd_name().c_str(),
-                signal
-            );
-
-#ifdef VERBOSE_VCD_FILE
-        fprintf(f, "fprintf(f, \"$comment '%s' $end\\n\");\n",
-                node->name().c_str());
-#endif
-
-        /* The last path is always equal to the current one -- note
-         * that sometimes this won't do anything as it'll be the same,
-         * but this strictly enforces this condition. */
-        last_path = module;
-    }
-
-    for (ssize_t i = 0; i < scope; i++)
-        fprintf(f, "    fprintf(f, \"$upscope $end\\n\");\n");
-
-    fprintf(f, "    fprintf(f, \"$scope module %s $end\\n\");\n",
-            "_chisel_temps_");
-
-    for (const auto& node: flo->nodes()) {
-        if (node->vcd_exported() == false)
-            continue;
-
-        if (node->chisel_temp() == false)
-            continue;
-
-        fprintf(f, "    fprintf(f, \"$var wire " SIZET_FORMAT " %s %s $end\\n\");\n",
-                node->width(),
-                node->vcd_name().c_str(),
-                node->name().c_str()
-            );
-    }
-
-    fprintf(f, "    fprintf(f, \"$upscope $end\\n\");\n");
-
-    fprintf(f, "  fprintf(f, \"$enddefinitions $end\\n\");\n");
-    fprintf(f, "  fprintf(f, \"$dumpvars\\n\");\n");
-    fprintf(f, "  fprintf(f, \"$end\\n\");\n");
-
-    fprintf(f, "  }\n");
-
-    fprintf(f, "  fprintf(f, \"#%%lu\\n\", cycle);\n");
-
-    for (const auto& node: flo->nodes()) {
-        if (node->vcd_exported() == false)
-            continue;
-
-#ifndef UNCOMPRESSED_VCD
-        fprintf(f,
-                "  if ((cycle == 0) || (%s__prev != %s))",
-                node->mangled_name().c_str(),
-                node->mangled_name().c_str()
-            );
-#endif
-
-        fprintf(f, "  {\n");
-
-#ifdef VERBOSE_VCD_FILE
-        fprintf(f, "    fprintf(f, \"$comment '%s' $end\\n\");\n",
-                node->name().c_str());
-#endif
-
-        fprintf(f, "    fprintf(f, \"b\");\n");
-        for (auto i = node->width(); i > 0; i--) {
-            fprintf(f, "    fprintf(f, \"%%lu\", (%s.values[" SIZET_FORMAT "] >> " SIZET_FORMAT ") & 1);",
-                    node->mangled_name().c_str(),
-                    (i - 1) / 64,
-                    (i - 1) % 64
-                );
-        }
-        fprintf(f, "    fprintf(f, \" %s\\n\");\n",
-                node->vcd_name().c_str());
-
-        fprintf(f, "    %s__prev = %s;\n",
-                node->mangled_name().c_str(),
-                node->mangled_name().c_str()
-            );
-
-        fprintf(f, "  }\n");
-    }
-
-    fprintf(f, "}\n");
+    generate_dump(flo, opts, f, in_header);
 
     /* This function is part of the debug API wrapper, which now
      * contains all the string-lookup stuff. */
-    fprintf(f, "void %s_api_t::init_mapping_table(void) {\n",
-            flo->class_name().c_str());
+    fprintf(f, "%svoid %s_api_t::init_mapping_table(void) {\n",
+            inl, flo->class_name().c_str());
 
     fprintf(f, "  dat_table.clear();\n");
     fprintf(f, "  mem_table.clear();\n");
@@ -599,8 +968,8 @@ int generate_compat(const flo_ptr flo, FILE *f)
     fprintf(f, "}\n");
 
     /* This function is used by the snapshot interface? */
-    fprintf(f, "mod_t *%s_t::clone(void) {\n",
-            flo->class_name().c_str());
+    fprintf(f, "%smod_t *%s_t::clone(void) {\n",
+            inl, flo->class_name().c_str());
     fprintf(f, "  mod_t *cloned = new %s_t(*this);\n",
             flo->class_name().c_str());
     fprintf(f, "  return cloned;\n");
@@ -608,19 +977,190 @@ int generate_compat(const flo_ptr flo, FILE *f)
 
     /* This function is also used by the snapshot interface. */
     /* FIXME: This should probably be implemented... */
-    fprintf(f, "bool %s_t::set_circuit_from(mod_t *src) {\n",
-            flo->class_name().c_str());
+    fprintf(f, "%sbool %s_t::set_circuit_from(mod_t *src) {\n",
+            inl, flo->class_name().c_str());
     fprintf(f, "  return false;\n");
     fprintf(f, "}\n");
 
+    if (opts.activity() == true) {
+        cones c(flo);
+
+        fprintf(f, "%svoid %s_t::dump_activity(FILE *f) {\n",
+                inl, flo->class_name().c_str());
+        fprintf(f, "  unsigned long n = this->__activity_cycles[0];\n");
+        for (size_t i = 0; i < c.size(); ++i) {
+            fprintf(f, "  fprintf(f, \"cone " SIZET_FORMAT ": " SIZET_FORMAT " ops, " SIZET_FORMAT " triggers%s, %%lu/%%lu cycles\\n\", (unsigned long)this->__activity[" SIZET_FORMAT "], n);\n",
+                    i,
+                    c.at(i).ops().size(),
+                    c.at(i).imports().size(),
+                    c.at(i).always() ? " (always)" : "",
+                    i);
+        }
+        fprintf(f, "}\n");
+    }
+
+    if (opts.profile() == true) {
+        fprintf(f, "%svoid %s_t::dump_profile(FILE *f) {\n",
+                inl, flo->class_name().c_str());
+        for (int c = 0; c < PROFILE_CLASSES; ++c) {
+            fprintf(f, "  fprintf(f, \"profile %s: %%lu cycles, %%lu ops\\n\", (unsigned long)this->__profile[%d], (unsigned long)this->__profile[%d]);\n",
+                    profile_class_name((enum profile_class)c),
+                    2 * c,
+                    2 * c + 1);
+        }
+        fprintf(f, "}\n");
+    }
+
     return 0;
 }
 
-int generate_llvmir(const flo_ptr flo, FILE *f)
+int generate_llvmir(const flo_ptr flo, const options& opts, FILE *f,
+                    bool split)
 {
     /* This writer outputs LLVM IR to the given file. */
-    llvm out(f);
+    libcodegen::llvm out(f);
+
+    /* Every fix_t holds a value for each lane that's being simulated,
+     * so they must all be vectors when there's more than one. */
+    fix_t::set_lanes(opts.lanes());
+
+    /* The location of every node that's stored in the flat state,
+     * which is only used when flo-llvm owns the state. */
+    partitions parts(flo, opts.threads(), opts.chunk());
+    auto layout = layout_state(flo, opts);
+
+    /* Small designs aren't split between as many threads as were
+     * asked for, which would otherwise go unnoticed. */
+    if (parts.threads() < opts.threads()) {
+        fprintf(stderr, "flo-llvm: split between " SIZET_FORMAT " of " SIZET_FORMAT " threads, the design is too small for more\n",
+                parts.threads(),
+                opts.threads());
+    }
+
+    /* When splitting, clock_lo goes into the first module and every
+     * partition gets a module of its own.  Each one starts with a
+     * comment line that names it, which is how the wrapper tells
+     * them apart. */
+    if (split == true)
+        fprintf(f, "; flo-llvm module design\n");
+
+    generate_declarations(out, flo, opts, flo->operations());
+
+    /* Here we generate clock_lo, which performs all the logic
+     * operations but does not perform any register writes.  In order
+     * to do this we'll have to walk through the computation in
+     * dataflow order. */
+    clock_lo_func clock_lo("_llvmflo_%s_clock_lo", flo->class_name().c_str());
+    if (opts.activity() == true) {
+        generate_activity(out, f, flo, opts, layout);
+        return 0;
+    }
+
+    if (parts.threads() == 1 && parts.stages() == 1) {
+        clock_lo_frame frame;
+        auto lo = out.define(clock_lo, {&frame.dut, &frame.rst});
+        generate_prologue(lo, flo, opts, layout, frame);
+
+        /* The code is already in dataflow order so all we need to do
+         * is emit the computation out to LLVM. */
+        for (const auto& op: flo->operations())
+            generate_op(lo, op, opts, layout, op->writeback(), frame);
 
+        /* The next value of every register gets stored into its
+         * shadow, which allows clock_hi to be a single copy. */
+        if (opts.native_state() == true) {
+            for (const auto& op: flo->operations()) {
+                if (op->op() != libflo::opcode::REG)
+                    continue;
+
+                generate_next(lo, op, opts, layout, frame);
+            }
+        }
+
+        generate_profile_flush(lo, opts, frame);
+        fprintf(f, "  ret void\n");
+        return 0;
+    }
+
+    /* When clock_lo is split between threads (or into chunks) every
+     * partition becomes its own function.  Anything a partition needs
+     * that it doesn't compute itself has already been stored into the
+     * state by an earlier stage, so it's just loaded up front. */
+    auto pieces = [&](std::function<void(size_t, size_t)> func) {
+        for (size_t s = 0; s < parts.stages(); ++s)
+            for (size_t t = 0; t < parts.threads(); ++t)
+                if (parts.at(s, t).empty() == false)
+                    func(s, t);
+    };
+
+    if (split == true) {
+        pieces([&](size_t s, size_t t) {
+                clock_lo_func func(parts.function_name(flo, s, t).c_str());
+                out.declare(func);
+            });
+    } else {
+        pieces([&](size_t s, size_t t) {
+                const auto& part = parts.at(s, t);
+                generate_piece(out, f, flo, parts.function_name(flo, s, t),
+                               part.imports(), part.ops(), part.nexts(),
+                               parts.shared(), opts, layout, false);
+            });
+    }
+
+    /* clock_lo itself still exists and just runs every partition in
+     * order, which is always safe as the partitions in a stage are
+     * independent of each other. */
+    {
+        clock_lo_frame frame;
+        auto lo = out.define(clock_lo, {&frame.dut, &frame.rst});
+
+        pieces([&](size_t s, size_t t) {
+                clock_lo_func func(parts.function_name(flo, s, t).c_str());
+                lo->operate(call_op(func, {&frame.dut, &frame.rst}));
+            });
+
+        fprintf(f, "  ret void\n");
+    }
+
+    /* The pieces of a split build find the fields of the state through
+     * globals, which only the link module knows the values of. */
+    if (split == true) {
+        for (const auto& field: layout.fields()) {
+            if (field.padding() == true)
+                continue;
+
+            fprintf(f, "@%s%s = constant i64 " SIZET_FORMAT "\n",
+                    fields_prefix(flo).c_str(),
+                    field.name().c_str(),
+                    field.offset());
+        }
+    }
+
+    /* Temporary names are restarted for every module so that a piece
+     * generates exactly the same IR no matter what came before it,
+     * which lets the wrapper cache the objects it builds. */
+    if (split == true) {
+        pieces([&](size_t s, size_t t) {
+                const auto& part = parts.at(s, t);
+                auto name = parts.function_name(flo, s, t);
+
+                fprintf(f, "; flo-llvm module %s\n", name.c_str());
+                libcodegen::value::reset_unique_names();
+                generate_declarations(out, flo, opts, part.ops());
+                generate_piece(out, f, flo, name,
+                               part.imports(), part.ops(), part.nexts(),
+                               parts.shared(), opts, layout, true);
+            });
+    }
+
+    return 0;
+}
+
+void generate_declarations(libcodegen::llvm& out,
+                           const flo_ptr flo,
+                           const options& opts,
+                           const std::vector<std::shared_ptr< ::operation>>& ops)
+{
     /* Generate declarations for some external functions that get used
      * by generated code below. */
     function< builtin<void>,
@@ -642,22 +1182,49 @@ int generate_llvmir(const flo_ptr flo, FILE *f)
         extern_memset("llvm.memset.p0i8.i64");
     out.declare(extern_memset);
 
-    /* These symbols are generated by the compatibility layer but
-     * still need declarations so LLVM can check their types.  Note
-     * that here I'm just manually handling this type safety, which is
-     * probably nasty... */
-    for (const auto& node: flo->nodes()) {
-        if (node->exported() == false)
+    /* LOG2 counts leading zeros, which is an intrinsic that needs a
+     * declaration for every width it's used with. */
+    std::map<size_t, bool> ctlz_widths;
+    for (const auto& op: ops) {
+        if (op->op() != libflo::opcode::LOG2)
             continue;
 
-        if (node->is_mem() == true) {
-            out.declare(node->getm_func(),
+        auto width = op->s()->width();
+        if (ctlz_widths.find(width) != ctlz_widths.end())
+            continue;
+
+        ctlz_widths[width] = true;
+        out.declare(ctlz_func(width));
+    }
+
+    /* Profiled builds read the cycle counter between operations. */
+    if (opts.profile() == true) {
+        out.declare(readcyclecounter_func("llvm.readcyclecounter"));
+
+        if (opts.native_state() == false) {
+            out.declare(profile_func("_llvmflo_%s_profile",
+                                     flo->class_name().c_str()));
+        }
+    }
+
+    /* These symbols are generated by the compatibility layer but
+     * still need declarations so LLVM can check their types.  Note
+     * that here I'm just manually handling this type safety, which is
+     * probably nasty... */
+    for (const auto& node: flo->nodes()) {
+        if (node->exported() == false)
+            continue;
+
+        if (node->is_mem() == true && opts.native_state() == true) {
+            /* Memories are stored directly in native states. */
+        } else if (node->is_mem() == true) {
+            out.declare(node->getm_func(),
                         libcodegen::llvm::declare_flags_inline
                 );
             out.declare(node->setm_func(),
                         libcodegen::llvm::declare_flags_inline
                 );
-        } else {
+        } else if (opts.native_state() == false) {
             out.declare(node->get_func(),
                         libcodegen::llvm::declare_flags_inline
                 );
@@ -666,322 +1233,817 @@ int generate_llvmir(const flo_ptr flo, FILE *f)
                 );
         }
     }
+}
 
-    /* Here we generate clock_lo, which performs all the logic
-     * operations but does not perform any register writes.  In order
-     * to do this we'll have to walk through the computation in
-     * dataflow order. */
-    function< builtin<void>,
-              arglist2<pointer<builtin<void>>,
-                       builtin<bool>
-                       >
-              >
-        clock_lo("_llvmflo_%s_clock_lo", flo->class_name().c_str());
-    {
-        auto dut = pointer<builtin<void>>("dut");
-        auto dut_vec = std::vector<value*>();
-        dut_vec.push_back(&dut);
+state_layout layout_state(const flo_ptr flo, const options& opts)
+{
+    /* Every class of work has a counter of cycles followed by a
+     * counter of how many times it was done. */
+    std::vector<std::pair<std::string, size_t>> raws;
+    if (opts.profile() == true)
+        raws.push_back(std::make_pair("__profile", 2 * PROFILE_CLASSES));
 
-        auto rst = builtin<bool>("rst");
-        auto rst_vec = std::vector<value*>();
-        rst_vec.push_back(&rst);
+    if (opts.activity() == true) {
+        cones c(flo);
 
-        auto lo = out.define(clock_lo, {&dut, &rst});
+        raws.push_back(std::make_pair("__activity_full", 1));
+        raws.push_back(std::make_pair("__activity_cycles", 1));
+        raws.push_back(std::make_pair("__activity", c.size()));
 
-        /* The code is already in dataflow order so all we need to do
-         * is emit the computation out to LLVM. */
-        for (const auto& op: flo->operations()) {
-            /* This contains a count of the number of i64-wide
-             * operations that need to be performed in order to make
-             * this operation succeed. */
-            auto i64cnt = constant<uint32_t>((op->d()->width() + 63) / 64);
-
-            lo->comment("");
-            lo->comment(" *** Chisel Node: %s", op->to_string().c_str());
-            lo->comment("");
-
-            bool nop = false;
-            switch (op->op()) {
-                /* The following nodes are just no-ops in this phase, they
-                 * only show up in the clock_hi phase. */
-            case libflo::opcode::OUT:
-                lo->operate(mov_op(op->dv(), op->sv()));
-                break;
+        return state_layout(flo, opts.lanes(), c.retained(),
+                            c.triggers(), raws);
+    }
 
-            case libflo::opcode::ADD:
-                lo->operate(add_op(op->dv(), op->sv(), op->tv()));
-                break;
+    partitions parts(flo, opts.threads(), opts.chunk());
+    return state_layout(flo, opts.lanes(), parts.shared(), {}, raws);
+}
 
-            case libflo::opcode::AND:
-                lo->operate(and_op(op->dv(), op->sv(), op->tv()));
-                break;
+void generate_piece(libcodegen::llvm& out,
+                    FILE *f,
+                    const flo_ptr flo,
+                    const std::string name,
+                    const std::vector<std::shared_ptr<node>>& imports,
+                    const std::vector<std::shared_ptr< ::operation>>& ops,
+                    const std::vector<std::shared_ptr< ::operation>>& nexts,
+                    const std::vector<std::shared_ptr<node>>& stored,
+                    const options& opts,
+                    const state_layout& layout,
+                    bool split)
+{
+    std::map<std::string, bool> is_stored;
+    for (const auto& n: stored)
+        is_stored[n->name()] = true;
+
+    clock_lo_func func(name.c_str());
+    clock_lo_frame frame;
+    if (split == true)
+        frame.fields_prefix = fields_prefix(flo);
+
+    auto lo = out.define(func, {&frame.dut, &frame.rst});
+    generate_prologue(lo, flo, opts, layout, frame);
+
+    for (const auto& n: imports) {
+        lo->comment(" *** Import: %s", n->name().c_str());
+        generate_profile(lo, opts, frame, PROFILE_READ);
+        load_state(lo, n->cg_name(), frame, layout,
+                   layout.offset(n), (n->width() + 63) / 64,
+                   opts.lanes());
+    }
 
-            case libflo::opcode::DIV:
-                lo->operate(div_op(op->dv(), op->sv(), op->tv()));
-                break;
+    for (const auto& op: ops) {
+        auto writeback = op->writeback()
+            || is_stored.find(op->d()->name()) != is_stored.end();
+        generate_op(lo, op, opts, layout, writeback, frame);
+    }
 
-            case libflo::opcode::CAT:
-            case libflo::opcode::CATD:
-            {
-                auto se = fix_t(op->d()->width());
-                auto te = fix_t(op->d()->width());
-                lo->operate(zero_ext_op(se, op->sv()));
-                lo->operate(zero_ext_op(te, op->tv()));
+    for (const auto& op: nexts)
+        generate_next(lo, op, opts, layout, frame);
 
-                auto ss = fix_t(op->d()->width());
-                lo->operate(lsh_op(ss, se, constant<uint64_t>(op->width())));
+    generate_profile_flush(lo, opts, frame);
+    fprintf(f, "  ret void\n");
 
-                lo->operate(or_op(op->dv(), te, ss));
+    /* The globals can only be declared once the function is closed,
+     * which is also when every one that's used is known. */
+    lo.reset();
+    for (const auto& field: frame.fields_used)
+        fprintf(f, "@%s = external constant i64\n", field.c_str());
+}
 
-                break;
+builtin<uint64_t> state_offset(std::shared_ptr<definition> lo,
+                               const state_layout& layout,
+                               clock_lo_frame& frame,
+                               size_t offset)
+{
+    if (frame.fields_prefix.size() == 0)
+        return constant<uint64_t>(offset);
+
+    const auto& field = layout.field_at(offset);
+    auto name = frame.fields_prefix + field.name();
+    frame.fields_used.insert(name);
+
+    auto start = builtin<uint64_t>();
+    lo->operate(load_op(start, global<builtin<uint64_t>>(name)));
+    if (offset == field.offset())
+        return start;
+
+    auto sum = builtin<uint64_t>();
+    lo->operate(add_op<builtin<uint64_t>>(
+                    sum, start,
+                    constant<uint64_t>(offset - field.offset())));
+    return sum;
+}
+
+std::string fields_prefix(const flo_ptr flo)
+{
+    return "_llvmflo_" + flo->class_name() + "_field_";
+}
+
+void generate_activity(libcodegen::llvm& out,
+                       FILE *f,
+                       const flo_ptr flo,
+                       const options& opts,
+                       const state_layout& layout)
+{
+    cones c(flo);
+
+    for (size_t i = 0; i < c.size(); ++i) {
+        const auto& cone = c.at(i);
+        generate_piece(out, f, flo, c.function_name(flo, i),
+                       cone.imports(), cone.ops(), cone.nexts(),
+                       c.retained(), opts, layout, false);
+    }
+
+    clock_lo_func clock_lo("_llvmflo_%s_clock_lo", flo->class_name().c_str());
+    clock_lo_frame frame;
+    auto lo = out.define(clock_lo, {&frame.dut, &frame.rst});
+    generate_prologue(lo, flo, opts, layout, frame);
+
+    /* Counters live in raw words of the state, which don't have a
+     * dat_t header. */
+    auto counter = [&](size_t offset) -> pointer<builtin<uint64_t>> {
+        auto ptr = pointer<builtin<uint64_t>>();
+        lo->operate(index_op(ptr, frame.state, constant<size_t>(offset)));
+        return ptr;
+    };
+    auto bump = [&](size_t offset) {
+        auto ptr = counter(offset);
+        auto value = builtin<uint64_t>();
+        lo->operate(load_op(value, ptr));
+        auto one = constant<uint64_t>(1);
+        auto sum = builtin<uint64_t>();
+        lo->operate(add_op<builtin<uint64_t>>(sum, value, one));
+        lo->operate(store_op(ptr, sum));
+    };
+    auto call = [&](size_t i) {
+        clock_lo_func func(c.function_name(flo, i).c_str());
+        lo->operate(call_op(func, {&frame.dut, &frame.rst}));
+        bump(layout.raw_offset("__activity") + i);
+    };
+
+    /* The first cycle (along with any that follow a busy cycle)
+     * evaluates everything, which avoids all the checks. */
+    auto full_ptr = counter(layout.raw_offset("__activity_full"));
+    auto full = builtin<uint64_t>();
+    lo->operate(load_op(full, full_ptr));
+    auto zero = constant<uint64_t>(0);
+    auto is_full = builtin<bool>();
+    lo->operate(cmp_neq_op<builtin<bool>, builtin<uint64_t>>(is_full, full, zero));
+
+    label full_label, check_label, done_label;
+    lo->operate(br_op(is_full, full_label, check_label));
+
+    lo->operate(label_op(full_label));
+    {
+        auto one = constant<uint64_t>(1);
+        auto left = builtin<uint64_t>();
+        lo->operate(sub_op<builtin<uint64_t>>(left, full, one));
+        lo->operate(store_op(full_ptr, left));
+
+        for (size_t i = 0; i < c.size(); ++i)
+            call(i);
+
+        lo->operate(br_op(done_label));
+    }
+
+    /* Otherwise each cone is only evaluated when one of its triggers
+     * differs from its value at the end of the last cycle.  Cones are
+     * checked in order, so triggers that are computed by another cone
+     * are always up to date. */
+    lo->operate(label_op(check_label));
+    {
+        size_t checked = 0;
+        auto active = std::vector<builtin<uint64_t>>(1);
+        lo->operate(mov_op<builtin<uint64_t>>(active[0], zero));
+
+        for (size_t i = 0; i < c.size(); ++i) {
+            const auto& cone = c.at(i);
+            if (cone.always() == true || cone.imports().size() == 0) {
+                call(i);
+                continue;
             }
 
-            case libflo::opcode::EQ:
-                lo->operate(cmp_eq_op(op->dv(), op->sv(), op->tv()));
-                break;
+            lo->comment(" *** Cone " SIZET_FORMAT, i);
+
+            auto changed = std::vector<fix_t>();
+            for (const auto& n: cone.imports()) {
+                auto words = (n->width() + 63) / 64;
+                auto now = fix_t(n->width());
+                auto last = fix_t(n->width());
+                load_state(lo, now, frame, layout, layout.offset(n), words, 1);
+                load_state(lo, last, frame, layout, layout.last_offset(n), words, 1);
+
+                auto differ = fix_t(1);
+                lo->operate(cmp_neq_op(differ, now, last));
+                if (changed.size() == 0) {
+                    changed.push_back(differ);
+                } else {
+                    changed.push_back(fix_t(1));
+                    lo->operate(or_op(changed[changed.size() - 1],
+                                      changed[changed.size() - 2],
+                                      differ));
+                }
+            }
 
-            case libflo::opcode::GTE:
-                lo->operate(cmp_gte_op(op->dv(), op->sv(), op->tv()));
-                break;
+            label run_label, skip_label;
+            lo->operate(br_op(changed[changed.size() - 1],
+                              run_label, skip_label));
+            lo->operate(label_op(run_label));
+            call(i);
+            lo->operate(br_op(skip_label));
+            lo->operate(label_op(skip_label));
+
+            auto ran = builtin<uint64_t>();
+            lo->operate(zext_trunc_op(ran, changed[changed.size() - 1]));
+            active.push_back(builtin<uint64_t>());
+            lo->operate(add_op(active[active.size() - 1],
+                               active[active.size() - 2],
+                               ran));
+            checked++;
+        }
 
-            case libflo::opcode::INIT:
-                /* The INIT operation does _nothing_ at runtime! */
-                nop = true;
-                break;
+        /* Checking isn't worth it when most of the design is active,
+         * so just evaluate everything for a while. */
+        auto limit = constant<uint64_t>(checked * cones::full_percent / 100);
+        auto busy = builtin<bool>();
+        lo->operate(cmp_lt_op<builtin<bool>, builtin<uint64_t>>(busy, limit, active[active.size() - 1]));
+        auto cycles = constant<uint64_t>(cones::full_cycles);
+        auto next_full = builtin<uint64_t>();
+        lo->operate(mux_op<builtin<bool>, builtin<uint64_t>>(next_full, busy, cycles, zero));
+        lo->operate(store_op(full_ptr, next_full));
+
+        lo->operate(br_op(done_label));
+    }
+
+    /* Every trigger's current value is the last value for the next
+     * cycle. */
+    lo->operate(label_op(done_label));
+    bump(layout.raw_offset("__activity_cycles"));
+    for (const auto& n: c.triggers()) {
+        auto words = (n->width() + 63) / 64;
+        auto now = fix_t(n->width());
+        load_state(lo, now, frame, layout, layout.offset(n), words, 1);
+        store_state(lo, now, frame, layout, layout.last_offset(n), words, 1);
+    }
 
-            case libflo::opcode::LOG2:
-            {
-                auto one = fix_t(op->s()->width());
-                lo->operate(zext_trunc_op(one, constant<uint32_t>(1)));
+    fprintf(f, "  ret void\n");
+}
 
-                std::vector<fix_t> lookup;
-                for (size_t i = 0; i < op->s()->width(); ++i)
-                    lookup.push_back(fix_t(op->d()->width()));
+clock_lo_frame::clock_lo_frame(void)
+    : dut("dut"),
+      rst("rst"),
+      state("state"),
+      rst_lanes(1),
+      profile("profile"),
+      ticks(),
+      pending_class(PROFILE_CLASSES),
+      pending_ops(0),
+      fields_prefix(""),
+      fields_used()
+{
+}
 
-                lo->operate(zext_trunc_op(lookup[0], constant<uint32_t>(0)));
+void generate_prologue(std::shared_ptr<definition> lo,
+                       const flo_ptr flo,
+                       const options& opts,
+                       const state_layout& layout,
+                       clock_lo_frame& frame)
+{
+    /* When flo-llvm owns the state, the pointer we're handed is
+     * really just an array of words. */
+    if (opts.native_state() == true)
+        lo->operate(bitcast_op(frame.state, frame.dut));
+
+    /* Every lane shares a single reset signal. */
+    if (opts.lanes() > 1) {
+        auto rst_elt = fix_t(1);
+        lo->operate(insertelement_op(rst_elt, frame.rst, 0));
+        lo->operate(broadcast_op(frame.rst_lanes, rst_elt, opts.lanes()));
+    }
 
-                for (size_t i = 1; i < op->s()->width(); ++i) {
-                    auto shift = fix_t(op->s()->width());
-                    lo->operate(lsh_op(shift, one, constant<uint64_t>(i)));
+    /* The first interval that's profiled starts right here. */
+    if (opts.profile() == true) {
+        if (opts.native_state() == true) {
+            auto offset = state_offset(lo, layout, frame,
+                                       layout.raw_offset("__profile"));
+            lo->operate(index_op(frame.profile, frame.state, offset));
+        } else {
+            profile_func func("_llvmflo_%s_profile",
+                              flo->class_name().c_str());
+            lo->operate(call_op(frame.profile, func, {&frame.dut}));
+        }
 
-                    auto cmp = fix_t(op->s()->width());
-                    lo->operate(cmp_gte_op(cmp, op->sv(), shift));
+        readcyclecounter_func readcyclecounter("llvm.readcyclecounter");
+        frame.ticks.push_back(builtin<uint64_t>());
+        lo->operate(call_op(frame.ticks[0], readcyclecounter));
+    }
+}
 
-                    auto iv = fix_t(op->d()->width());
-                    lo->operate(zext_trunc_op(iv, constant<size_t>(i)));
+void generate_profile(std::shared_ptr<definition> lo,
+                      const options& opts,
+                      clock_lo_frame& frame,
+                      enum profile_class c)
+{
+    if (opts.profile() == false)
+        return;
 
-                    auto log2 = lookup[i-1];
-                    auto nlog2 = lookup[i];
-                    lo->operate(mux_op(nlog2, cmp, iv, log2));
-                }
+    if (frame.pending_class != c)
+        generate_profile_flush(lo, opts, frame);
 
-                lo->operate(mov_op(op->dv(), lookup[lookup.size()-1]));
+    frame.pending_class = c;
+    frame.pending_ops++;
+}
 
-                break;
-            }
+void generate_profile_flush(std::shared_ptr<definition> lo,
+                            const options& opts,
+                            clock_lo_frame& frame)
+{
+    if (opts.profile() == false || frame.pending_ops == 0)
+        return;
+
+    auto c = frame.pending_class;
+    readcyclecounter_func readcyclecounter("llvm.readcyclecounter");
+    auto last = frame.ticks[frame.ticks.size() - 1];
+    auto now = builtin<uint64_t>();
+    lo->operate(call_op(now, readcyclecounter));
+
+    auto spent = builtin<uint64_t>();
+    lo->operate(sub_op<builtin<uint64_t>>(spent, now, last));
+
+    /* Counters are plain words, just like the activity counters. */
+    auto bump = [&](size_t offset, builtin<uint64_t> by) {
+        auto ptr = pointer<builtin<uint64_t>>();
+        lo->operate(index_op(ptr, frame.profile, constant<size_t>(offset)));
+        auto value = builtin<uint64_t>();
+        lo->operate(load_op(value, ptr));
+        auto sum = builtin<uint64_t>();
+        lo->operate(add_op<builtin<uint64_t>>(sum, value, by));
+        lo->operate(store_op(ptr, sum));
+    };
+    bump(2 * c, spent);
+    bump(2 * c + 1, constant<uint64_t>(frame.pending_ops));
+
+    frame.ticks.push_back(now);
+    frame.pending_ops = 0;
+}
 
-            case libflo::opcode::LT:
-                lo->operate(cmp_lt_op(op->dv(), op->sv(), op->tv()));
-                break;
+void generate_next(std::shared_ptr<definition> lo,
+                   const std::shared_ptr< ::operation> op,
+                   const options& opts,
+                   const state_layout& layout,
+                   clock_lo_frame& frame)
+{
+    lo->comment(" *** Next: %s", op->to_string().c_str());
+    generate_profile(lo, opts, frame, PROFILE_WRITE);
+    store_state(lo, op->tv(), frame, layout,
+                layout.next_offset(op->d()),
+                (op->d()->width() + 63) / 64,
+                opts.lanes());
+}
 
-            case libflo::opcode::LSH:
-            {
-                auto ed = fix_t(op->d()->width() + op->s()->width());
-                auto es = fix_t(op->d()->width() + op->s()->width());
-                auto et = fix_t(op->d()->width() + op->s()->width());
+void generate_op(std::shared_ptr<definition> lo,
+                 const std::shared_ptr< ::operation> op,
+                 const options& opts,
+                 const state_layout& layout,
+                 bool writeback,
+                 clock_lo_frame& frame)
+{
+    auto& dut = frame.dut;
+    auto& rst = frame.rst;
+    auto& rst_lanes = frame.rst_lanes;
+
+    /* This contains a count of the number of i64-wide
+     * operations that need to be performed in order to make
+     * this operation succeed. */
+    auto i64cnt = constant<uint32_t>((op->d()->width() + 63) / 64);
+
+    lo->comment("");
+    lo->comment(" *** Chisel Node: %s", op->to_string().c_str());
+    lo->comment("");
+
+    /* INIT doesn't emit anything, and there can be a lot of them. */
+    if (op->op() != libflo::opcode::INIT)
+        generate_profile(lo, opts, frame, profile_class_of(op->op()));
+
+    bool nop = false;
+    switch (op->op()) {
+        /* The following nodes are just no-ops in this phase, they
+         * only show up in the clock_hi phase. */
+    case libflo::opcode::OUT:
+        lo->operate(mov_op(op->dv(), op->sv()));
+        break;
+
+    case libflo::opcode::ADD:
+        if (generate_narrow(lo, op) == true)
+            break;
+        lo->operate(add_op(op->dv(), op->sv(), op->tv()));
+        break;
+
+    case libflo::opcode::AND:
+        if (generate_narrow(lo, op) == true)
+            break;
+        lo->operate(and_op(op->dv(), op->sv(), op->tv()));
+        break;
+
+    case libflo::opcode::DIV:
+        lo->operate(div_op(op->dv(), op->sv(), op->tv()));
+        break;
+
+    case libflo::opcode::CAT:
+    case libflo::opcode::CATD:
+    {
+        auto se = fix_t(op->d()->width());
+        auto te = fix_t(op->d()->width());
+        lo->operate(zero_ext_op(se, op->sv()));
+        lo->operate(zero_ext_op(te, op->tv()));
 
-                lo->operate(zext_trunc_op(es, op->sv()));
-                lo->operate(zext_trunc_op(et, op->tv()));
-                
-                lo->operate(lsh_op(ed, es, et));
+        auto ss = fix_t(op->d()->width());
+        lo->operate(lsh_op(ss, se, fix_constant(op->d()->width(),
+                                                op->width())));
 
-                lo->operate(zext_trunc_op(op->dv(), ed));
+        lo->operate(or_op(op->dv(), te, ss));
 
-                break;
-            }
+        break;
+    }
 
-            case libflo::opcode::MOV:
-                lo->operate(mov_op(op->dv(), op->sv()));
-                break;
+    case libflo::opcode::EQ:
+        lo->operate(cmp_eq_op(op->dv(), op->sv(), op->tv()));
+        break;
 
-            case libflo::opcode::MUL:
-            {
-                auto ext0 = fix_t(op->d()->width());
-                auto ext1 = fix_t(op->d()->width());
+    case libflo::opcode::GTE:
+        lo->operate(cmp_gte_op(op->dv(), op->sv(), op->tv()));
+        break;
 
-                lo->operate(zero_ext_op(ext0, op->sv()));
-                lo->operate(zero_ext_op(ext1, op->tv()));
-                lo->operate(mul_op(op->dv(), ext0, ext1));
-                break;
-            }
+    case libflo::opcode::INIT:
+        /* The INIT operation does _nothing_ at runtime! */
+        nop = true;
+        break;
 
-            case libflo::opcode::MUX:
-                lo->operate(mux_op(op->dv(),
-                                   op->sv(),
-                                   op->tv(),
-                                   op->uv()
-                                ));
-                break;
+    case libflo::opcode::LOG2:
+    {
+        /* The log of a value is the index of its highest set bit,
+         * which is found by counting its leading zeros.  Zero doesn't
+         * have any set bits, but its log is defined to be zero. */
+        auto width = op->s()->width();
 
-            case libflo::opcode::NEG:
-            {
-                auto zero = fix_t(op->s()->width());
-                lo->operate(zext_trunc_op(zero, constant<uint64_t>(0)));
-                lo->operate(sub_op(op->dv(), zero, op->sv()));
-                break;
-            }
+        auto zeros = fix_t(width);
+        lo->operate(ctlz_op(zeros, op->sv()));
 
-            case libflo::opcode::NEQ:
-                lo->operate(cmp_neq_op(op->dv(), op->sv(), op->tv()));
-                break;
+        auto log2 = fix_t(width);
+        lo->operate(sub_op(log2, fix_constant(width, width - 1), zeros));
 
-            case libflo::opcode::NOT:
-                lo->operate(not_op(op->dv(), op->sv()));
-                break;
+        auto is_zero = fix_t(1);
+        lo->operate(cmp_eq_op(is_zero, op->sv(), fix_constant(width, 0)));
 
-            case libflo::opcode::OR:
-                lo->operate(or_op(op->dv(), op->sv(0), op->sv(1)));
-                break;
+        auto safe = fix_t(width);
+        lo->operate(mux_op(safe, is_zero, fix_constant(width, 0), log2));
 
-            case libflo::opcode::RD:
-            {
-                auto index = op->uv();
-                auto index64 = builtin<uint64_t>();
-                lo->operate(zero_ext_op(index64, index));
+        lo->operate(zext_trunc_op(op->dv(), safe));
 
-                auto ptr64 = pointer<builtin<uint64_t>>();
-                lo->operate(alloca_op(ptr64, i64cnt));
-                lo->operate(call_op(op->t()->getm_func(),
-                                    {&dut, &index64, &ptr64}));
-                array2int(lo, op->dv(), ptr64, i64cnt);
+        break;
+    }
 
-                break;
-            }
+    case libflo::opcode::LT:
+        lo->operate(cmp_lt_op(op->dv(), op->sv(), op->tv()));
+        break;
 
-            case libflo::opcode::IN:
-            case libflo::opcode::REG:
-            {
-                nop = true;
+    case libflo::opcode::LSH:
+    {
+        /* Bits that are shifted past the result's width are lost, so
+         * the shift can be done right in that width.  LLVM doesn't
+         * define shifts by the whole width or more, so those need to
+         * be made into zero explicitly. */
+        auto width = op->d()->width();
+
+        auto es = fix_t(width);
+        lo->operate(zext_trunc_op(es, op->sv()));
+
+        uint64_t shift;
+        if (op->t()->const_value(shift) == true) {
+            if (shift >= width)
+                lo->operate(mov_op(op->dv(), fix_constant(width, 0)));
+            else
+                lo->operate(lsh_op(op->dv(), es, fix_constant(width, shift)));
+            break;
+        }
 
-                auto ptr64 = pointer<builtin<uint64_t>>();
-                lo->operate(alloca_op(ptr64, i64cnt));
-                lo->operate(call_op(op->d()->get_func(), {&dut, &ptr64}));
-                array2int(lo, op->dv(), ptr64, i64cnt);
+        auto et = fix_t(width);
+        lo->operate(zext_trunc_op(et, op->tv()));
 
-                break;
-            }
+        if (op->t()->width() < 64 && (1ULL << op->t()->width()) <= width) {
+            lo->operate(lsh_op(op->dv(), es, et));
+            break;
+        }
 
-            case libflo::opcode::ARSH:
-            case libflo::opcode::RSH:
-            case libflo::opcode::RSHD:
-            {
-                auto cast = fix_t(op->s()->width());
-                lo->operate(zext_trunc_op(cast, op->tv()));
+        auto over = fix_t(1);
+        lo->operate(cmp_gte_op(over, op->tv(),
+                               fix_constant(op->t()->width(), width)));
 
-                auto shifted = fix_t(op->s()->width());
-                if (op->op() == libflo::opcode::ARSH)
-                    lo->operate(arsh_op(shifted, op->sv(), cast));
-                else
-                    lo->operate(lrsh_op(shifted, op->sv(), cast));
+        auto shifted = fix_t(width);
+        lo->operate(lsh_op(shifted, es, et));
 
-                auto zero = fix_t(op->t()->width());
-                lo->operate(zext_trunc_op(zero, constant<uint64_t>(0)));
+        lo->operate(mux_op(op->dv(), over,
+                           fix_constant(width, 0), shifted));
 
-                auto is_zero = builtin<bool>();
-                lo->operate(cmp_eq_op(is_zero, op->tv(), zero));
+        break;
+    }
 
-                auto zero_check = fix_t(cast.width());
-                lo->operate(mux_op(zero_check, is_zero, op->sv(), shifted));
+    case libflo::opcode::MOV:
+        lo->operate(mov_op(op->dv(), op->sv()));
+        break;
 
-                lo->operate(zext_trunc_op(op->dv(), zero_check));
+    case libflo::opcode::MUL:
+    {
+        if (generate_narrow(lo, op) == true)
+            break;
 
-                break;
-            }
+        auto ext0 = fix_t(op->d()->width());
+        auto ext1 = fix_t(op->d()->width());
 
-            case libflo::opcode::RST:
-                lo->operate(unsafemov_op(op->dv(), rst));
-                break;
+        lo->operate(zero_ext_op(ext0, op->sv()));
+        lo->operate(zero_ext_op(ext1, op->tv()));
+        lo->operate(mul_op(op->dv(), ext0, ext1));
+        break;
+    }
 
-            case libflo::opcode::SUB:
-                lo->operate(sub_op(op->dv(), op->sv(), op->tv()));
-                break;
+    case libflo::opcode::MUX:
+        lo->operate(mux_op(op->dv(),
+                           op->sv(),
+                           op->tv(),
+                           op->uv()
+                        ));
+        break;
+
+    case libflo::opcode::NEG:
+    {
+        auto zero = fix_constant(op->s()->width(), 0);
+        lo->operate(sub_op(op->dv(), zero, op->sv()));
+        break;
+    }
 
-            case libflo::opcode::WR:
-            {
-                auto index = op->uv();
-                auto index64 = builtin<uint64_t>();
-                lo->operate(zero_ext_op(index64, index));
-
-                /* On a CPU we have to emulate WR with a
-                 * read-modify-write cycle: no modification is made if
-                 * write-enable is FALSE. */
-                auto read_value = fix_t(op->v()->width());
-
-                auto read_ptr = pointer<builtin<uint64_t>>();
-                lo->operate(alloca_op(read_ptr, i64cnt));
-                lo->operate(call_op(op->t()->getm_func(),
-                                    {&dut, &index64, &read_ptr}));
-                array2int(lo, read_value, read_ptr, i64cnt);
-
-                auto write_value = fix_t(op->v()->width());
-                lo->operate(mux_op(write_value,
-                                   op->sv(),
-                                   op->vv(),
-                                   read_value
-                                ));
-
-                auto write_ptr = pointer<builtin<uint64_t>>();
-                lo->operate(alloca_op(write_ptr, i64cnt));
-                int2array(lo, write_value, write_ptr, i64cnt);
-                lo->operate(call_op(op->t()->setm_func(),
-                                    {&dut, &index64, &write_ptr}));
-
-                /* WR doesn't return anything despite having a node in
-                 * there.  Don't attempt to write this back to the
-                 * header. */
-                nop = true;
+    case libflo::opcode::NEQ:
+        lo->operate(cmp_neq_op(op->dv(), op->sv(), op->tv()));
+        break;
 
-                break;
-            }
+    case libflo::opcode::NOT:
+        lo->operate(not_op(op->dv(), op->sv()));
+        break;
 
-            case libflo::opcode::XOR:
-                lo->operate(xor_op(op->dv(), op->sv(0), op->tv()));
-                break;
+    case libflo::opcode::OR:
+        if (generate_narrow(lo, op) == true)
+            break;
+        lo->operate(or_op(op->dv(), op->sv(0), op->sv(1)));
+        break;
+
+    case libflo::opcode::RD:
+    {
+        if (opts.lanes() > 1) {
+            mem_read_lanes(lo, op->dv(), frame, layout,
+                           op->t(), op->uv());
+            break;
+        }
+
+        if (opts.native_state() == true) {
+            mem_read(lo, op->dv(), frame, layout, op->t(), op->uv());
+            break;
+        }
+
+        auto index = op->uv();
+        auto index64 = builtin<uint64_t>();
+        lo->operate(zero_ext_op(index64, index));
+
+        auto ptr64 = pointer<builtin<uint64_t>>();
+        lo->operate(alloca_op(ptr64, i64cnt));
+        lo->operate(call_op(op->t()->getm_func(),
+                            {&dut, &index64, &ptr64}));
+        array2int(lo, op->dv(), ptr64, i64cnt);
+
+        break;
+    }
+
+    case libflo::opcode::IN:
+    case libflo::opcode::REG:
+    {
+        nop = true;
+
+        if (opts.native_state() == true) {
+            load_state(lo, op->dv(), frame, layout,
+                       layout.offset(op->d()), i64cnt,
+                       opts.lanes());
+            break;
+        }
+
+        auto ptr64 = pointer<builtin<uint64_t>>();
+        lo->operate(alloca_op(ptr64, i64cnt));
+        lo->operate(call_op(op->d()->get_func(), {&dut, &ptr64}));
+        array2int(lo, op->dv(), ptr64, i64cnt);
+
+        break;
+    }
 
-            case libflo::opcode::RND:
-            case libflo::opcode::EAT:
-            case libflo::opcode::LIT:
-            case libflo::opcode::MSK:
-            case libflo::opcode::LD:
-            case libflo::opcode::ST:
-            case libflo::opcode::MEM:
-            case libflo::opcode::NOP:
-                fprintf(stderr, "Unable to compute node '%s'\n",
-                        libflo::opcode_to_string(op->op()).c_str());
-                abort();
+    case libflo::opcode::ARSH:
+    case libflo::opcode::RSH:
+    case libflo::opcode::RSHD:
+    {
+        /* Shifts by a constant are by far the most common, and are
+         * just a single shift when they're in range. */
+        uint64_t shift;
+        if (op->t()->const_value(shift) == true) {
+            auto width = op->s()->width();
+            auto arith = (op->op() == libflo::opcode::ARSH);
+            if (shift >= width && arith == false) {
+                lo->operate(mov_op(op->dv(), fix_constant(op->d()->width(), 0)));
                 break;
             }
+            if (shift >= width)
+                shift = width - 1;
 
-            /* Every node that's in the Chisel header gets stored after
-             * its cooresponding computation, but only when the node
-             * appears in the Chisel header. */
-            if (op->writeback() == true && nop == false) {
-                lo->comment("  Writeback");
+            auto shifted = fix_t(width);
+            if (arith == true)
+                lo->operate(arsh_op(shifted, op->sv(), fix_constant(width, shift)));
+            else
+                lo->operate(lrsh_op(shifted, op->sv(), fix_constant(width, shift)));
 
-                auto ptr64 = pointer<builtin<uint64_t>>();
-                lo->operate(alloca_op(ptr64, i64cnt));
-                int2array(lo, op->dv(), ptr64, i64cnt);
-                lo->operate(call_op(op->d()->set_func(), {&dut, &ptr64}));
-            }
+            lo->operate(zext_trunc_op(op->dv(), shifted));
+            break;
         }
 
-        fprintf(f, "  ret void\n");
+        auto cast = fix_t(op->s()->width());
+        lo->operate(zext_trunc_op(cast, op->tv()));
+
+        auto shifted = fix_t(op->s()->width());
+        if (op->op() == libflo::opcode::ARSH)
+            lo->operate(arsh_op(shifted, op->sv(), cast));
+        else
+            lo->operate(lrsh_op(shifted, op->sv(), cast));
+
+        auto zero = fix_constant(op->t()->width(), 0);
+
+        auto is_zero = fix_t(1);
+        lo->operate(cmp_eq_op(is_zero, op->tv(), zero));
+
+        auto zero_check = fix_t(cast.width());
+        lo->operate(mux_op(zero_check, is_zero, op->sv(), shifted));
+
+        lo->operate(zext_trunc_op(op->dv(), zero_check));
+
+        break;
     }
 
-    return 0;
+    case libflo::opcode::RST:
+        if (opts.lanes() > 1)
+            lo->operate(unsafemov_op(op->dv(), rst_lanes));
+        else
+            lo->operate(unsafemov_op(op->dv(), rst));
+        break;
+
+    case libflo::opcode::SUB:
+        lo->operate(sub_op(op->dv(), op->sv(), op->tv()));
+        break;
+
+    case libflo::opcode::WR:
+    {
+        /* WR doesn't return anything despite having a node in
+         * there.  Don't attempt to write this back to the
+         * header. */
+        nop = true;
+
+        if (opts.lanes() > 1) {
+            mem_write_lanes(lo, frame, layout, op->t(),
+                            op->sv(), op->uv(), op->vv());
+            break;
+        }
+
+        if (opts.native_state() == true) {
+            mem_write(lo, frame, layout, op->t(),
+                      op->sv(), op->uv(), op->vv());
+            break;
+        }
+
+        auto index = op->uv();
+        auto index64 = builtin<uint64_t>();
+        lo->operate(zero_ext_op(index64, index));
+
+        /* On a CPU we have to emulate WR with a
+         * read-modify-write cycle: no modification is made if
+         * write-enable is FALSE. */
+        auto read_value = fix_t(op->v()->width());
+
+        auto read_ptr = pointer<builtin<uint64_t>>();
+        lo->operate(alloca_op(read_ptr, i64cnt));
+        lo->operate(call_op(op->t()->getm_func(),
+                            {&dut, &index64, &read_ptr}));
+        array2int(lo, read_value, read_ptr, i64cnt);
+
+        auto write_value = fix_t(op->v()->width());
+        lo->operate(mux_op(write_value,
+                           op->sv(),
+                           op->vv(),
+                           read_value
+                        ));
+
+        auto write_ptr = pointer<builtin<uint64_t>>();
+        lo->operate(alloca_op(write_ptr, i64cnt));
+        int2array(lo, write_value, write_ptr, i64cnt);
+        lo->operate(call_op(op->t()->setm_func(),
+                            {&dut, &index64, &write_ptr}));
+        break;
+    }
+
+    case libflo::opcode::XOR:
+        if (generate_narrow(lo, op) == true)
+            break;
+        lo->operate(xor_op(op->dv(), op->sv(0), op->tv()));
+        break;
+
+    case libflo::opcode::RND:
+    case libflo::opcode::EAT:
+    case libflo::opcode::LIT:
+    case libflo::opcode::MSK:
+    case libflo::opcode::LD:
+    case libflo::opcode::ST:
+    case libflo::opcode::MEM:
+    case libflo::opcode::NOP:
+        fprintf(stderr, "Unable to compute node '%s'\n",
+                libflo::opcode_to_string(op->op()).c_str());
+        abort();
+        break;
+    }
+
+    /* Every node that's in the Chisel header gets stored after
+     * its cooresponding computation, but only when the node
+     * appears in the Chisel header. */
+    if (writeback == true && nop == false) {
+        lo->comment("  Writeback");
+        generate_profile(lo, opts, frame, PROFILE_WRITE);
+
+        if (opts.native_state() == true) {
+            store_state(lo, op->dv(), frame, layout,
+                        layout.offset(op->d()), i64cnt,
+                        opts.lanes());
+        } else {
+            auto ptr64 = pointer<builtin<uint64_t>>();
+            lo->operate(alloca_op(ptr64, i64cnt));
+            int2array(lo, op->dv(), ptr64, i64cnt);
+            lo->operate(call_op(op->d()->set_func(), {&dut, &ptr64}));
+        }
+    }
+}
+
+bool generate_narrow(std::shared_ptr<definition> lo,
+                     const std::shared_ptr< ::operation> op)
+{
+    if (op->d()->width() <= 64)
+        return false;
+
+    if (op->d()->live_width() > 64
+        || op->s()->live_width() > 64
+        || op->t()->live_width() > 64)
+        return false;
+
+    switch (op->op()) {
+    case libflo::opcode::ADD:
+    case libflo::opcode::AND:
+    case libflo::opcode::MUL:
+    case libflo::opcode::OR:
+    case libflo::opcode::XOR:
+        break;
+
+    default:
+        return false;
+    }
+
+    auto s = fix_t(64);
+    lo->operate(zext_trunc_op(s, op->sv()));
+
+    auto t = fix_t(64);
+    lo->operate(zext_trunc_op(t, op->tv()));
+
+    auto r = fix_t(64);
+    switch (op->op()) {
+    case libflo::opcode::ADD:
+        lo->operate(add_op(r, s, t));
+        break;
+    case libflo::opcode::AND:
+        lo->operate(and_op(r, s, t));
+        break;
+    case libflo::opcode::MUL:
+        lo->operate(mul_op(r, s, t));
+        break;
+    case libflo::opcode::OR:
+        lo->operate(or_op(r, s, t));
+        break;
+    case libflo::opcode::XOR:
+        lo->operate(xor_op(r, s, t));
+        break;
+    default:
+        break;
+    }
+
+    lo->operate(zext_trunc_op(op->dv(), r));
+    return true;
 }
 
-int generate_harness(const flo_ptr flo, FILE *f)
+int generate_harness(const flo_ptr flo, const options& opts, FILE *f)
 {
     /* Depend on the header file that was generated earlier. */
     fprintf(f, "#include \"%s.h\"\n", flo->class_name().c_str());
@@ -1015,79 +2077,868 @@ int generate_harness(const flo_ptr flo, FILE *f)
 
     fprintf(f, "  fclose(f);\n");
     fprintf(f, "  fclose(tee);\n");
+
+    /* Profiled builds report where clock_lo spent its time once the
+     * whole run is over. */
+    if (opts.profile() == true)
+        fprintf(f, "  module->dump_profile(stderr);\n");
     fprintf(f, "  return 0;");
     fprintf(f, "}\n");
 
     return 0;
 }
 
-bool strsta(const std::string haystack, const std::string needle)
+int generate_lanes_header(const flo_ptr flo, const options& opts, FILE *f)
 {
-    const char *h = haystack.c_str();
-    const char *n = needle.c_str();
+    auto layout = layout_state(flo, opts);
 
-    return (strncmp(h, n, strlen(n)) == 0);
-}
+    fprintf(f, "#include <stddef.h>\n");
+    fprintf(f, "#include <stdint.h>\n");
+    fprintf(f, "#include <stdio.h>\n");
+    fprintf(f, "#include <string.h>\n");
 
-void array2int(std::shared_ptr<definition> lo,
-               fix_t d,
-               pointer<builtin<uint64_t>> ptr64,
-               size_t i64cnt)
-{
-    auto ptrs = std::vector<pointer<builtin<uint64_t>>>(i64cnt);
-    for (size_t i = 0; i < i64cnt; i++) {
-        auto index = constant<size_t>(i);
-        lo->operate(index_op(ptrs[i], ptr64, index));
-    }
+    /* Every word of every field is stored once for each lane, which
+     * is why the lane is the last index. */
+    fprintf(f, "struct alignas(" SIZET_FORMAT ") %s_state_t {\n",
+            state_layout::line_words * sizeof(uint64_t),
+            flo->class_name().c_str());
 
-    auto loads = std::vector<builtin<uint64_t>>(i64cnt);
-    for (size_t i = 0; i < i64cnt; ++i) {
-        lo->operate(load_op(loads[i], ptrs[i]));
-    }
+    for (const auto& field: layout.fields()) {
+        auto node = field.n();
 
-    auto extended = std::vector<fix_t>();
-    for (size_t i = 0; i < i64cnt; ++i) {
-        /* We need this push here because every one of these
-         * temporaries needs a new name which means the copy
-         * constructor can't be used.  The default constructor can't
-         * be used because we need to tag each fix with a width. */
-        extended.push_back(fix_t(d.width()));
-        lo->operate(zext_trunc_op(extended[i], loads[i]));
+        if (node == NULL) {
+            fprintf(f, "    uint64_t %s[" SIZET_FORMAT "];\n",
+                    field.name().c_str(),
+                    field.words());
+        } else if (node->is_mem() == true) {
+            fprintf(f, "    uint64_t %s[" SIZET_FORMAT "][" SIZET_FORMAT "][" SIZET_FORMAT "];\n",
+                    node->mangled_name().c_str(),
+                    node->depth(),
+                    (node->width() + 63) / 64,
+                    opts.lanes());
+        } else {
+            fprintf(f, "    uint64_t %s[" SIZET_FORMAT "][" SIZET_FORMAT "];\n",
+                    field.name().c_str(),
+                    (node->width() + 63) / 64,
+                    opts.lanes());
+        }
     }
 
-    auto shifted = std::vector<fix_t>();
-    for (size_t i = 0; i < i64cnt; i++) {
-        shifted.push_back(fix_t(d.width()));
-        auto offset = constant<uint32_t>(i * 64);
-        lo->operate(lsh_op(shifted[i], extended[i], offset));
-    }
+    fprintf(f, "};\n");
 
-    auto ored = std::vector<fix_t>();
-    for (size_t i = 0; i < i64cnt; ++i) {
-        ored.push_back(fix_t(d.width()));
-        if (i == 0) {
-            lo->operate(mov_op(ored[i], shifted[i]));
+    partitions parts(flo, opts.threads(), opts.chunk());
+    if (parts.threads() > 1)
+        generate_pool(flo, parts, f);
+
+    fprintf(f, "class %s_t {\n", flo->class_name().c_str());
+    fprintf(f, "  public:\n");
+    fprintf(f, "    static const size_t lanes = " SIZET_FORMAT ";\n",
+            opts.lanes());
+    fprintf(f, "    %s_state_t state;\n", flo->class_name().c_str());
+    if (parts.threads() > 1)
+        fprintf(f, "    _llvmflo_%s_pool pool;\n", flo->class_name().c_str());
+
+    /* These mirror the Chisel interface, but operate on every lane at
+     * once.  There's only a single reset for all the lanes. */
+    fprintf(f, "  public:\n");
+    fprintf(f, "    void init(void);\n");
+    fprintf(f, "    void clock(bool reset);\n");
+    fprintf(f, "    void clock_lo(bool reset);\n");
+    fprintf(f, "    void clock_hi(bool reset);\n");
+
+    /* Individual lanes are accessed one word at a time.  Writes are
+     * masked to the width of the node, just like a dat_t. */
+    fprintf(f, "  public:\n");
+    for (const auto& node: flo->nodes()) {
+        if (node->exported() == false)
+            continue;
+
+        auto words = (node->width() + 63) / 64;
+        auto mask = node->width() % 64 == 0
+            ? std::string("")
+            : "      if (word == " + std::to_string(words - 1) + ") "
+              "value &= (1ULL << " + std::to_string(node->width() % 64) + ") - 1;\n";
+
+        if (node->is_mem() == true) {
+            fprintf(f, "    uint64_t peek_%s(size_t lane, size_t index, size_t word = 0) const\n",
+                    node->mangled_name().c_str());
+            fprintf(f, "      { return state.%s[index][word][lane]; }\n",
+                    node->mangled_name().c_str());
+            fprintf(f, "    void poke_%s(size_t lane, size_t index, uint64_t value, size_t word = 0) {\n",
+                    node->mangled_name().c_str());
+            fprintf(f, "%s", mask.c_str());
+            fprintf(f, "      state.%s[index][word][lane] = value;\n",
+                    node->mangled_name().c_str());
+            fprintf(f, "    }\n");
         } else {
-            lo->operate(or_op(ored[i], shifted[i], ored[i-1]));
+            fprintf(f, "    uint64_t peek_%s(size_t lane, size_t word = 0) const\n",
+                    node->mangled_name().c_str());
+            fprintf(f, "      { return state.%s[word][lane]; }\n",
+                    node->mangled_name().c_str());
+            fprintf(f, "    void poke_%s(size_t lane, uint64_t value, size_t word = 0) {\n",
+                    node->mangled_name().c_str());
+            fprintf(f, "%s", mask.c_str());
+            fprintf(f, "      state.%s[word][lane] = value;\n",
+                    node->mangled_name().c_str());
+            fprintf(f, "    }\n");
         }
     }
 
-    lo->operate(mov_op(d, ored[i64cnt-1]));
+    fprintf(f, "};\n");
+
+    return 0;
 }
 
-void int2array(std::shared_ptr<definition> lo,
-               fix_t d,
-               pointer<builtin<uint64_t>> ptr64,
-               size_t i64cnt)
+int generate_lanes_compat(const flo_ptr flo, const options& opts, FILE *f,
+                          bool in_header)
 {
-    auto shifted = std::vector<fix_t>();
-    for (size_t i = 0; i < i64cnt; ++i) {
-        shifted.push_back(fix_t(d.width()));
-        auto offset = constant<uint32_t>(i * 64);
-        lo->operate(lrsh_op(shifted[i], d, offset));
-    }
+    const char *inl = in_header ? "inline " : "";
 
-    auto trunced = std::vector<builtin<uint64_t>>(i64cnt);
+    partitions parts(flo, opts.threads(), opts.chunk());
+    auto layout = layout_state(flo, opts);
+
+    for (const auto& field: layout.fields()) {
+        if (field.n() == NULL)
+            continue;
+
+        fprintf(f, "static_assert(offsetof(%s_state_t, %s) == " SIZET_FORMAT ", \"state layout mismatch\");\n",
+                flo->class_name().c_str(),
+                field.name().c_str(),
+                field.offset() * sizeof(uint64_t));
+    }
+
+    fprintf(f, "static_assert(sizeof(%s_state_t) == " SIZET_FORMAT ", \"state layout mismatch\");\n",
+            flo->class_name().c_str(),
+            layout.words() * sizeof(uint64_t));
+
+    fprintf(f, "extern \"C\" {\n");
+    fprintf(f, "  void _llvmflo_%s_clock_lo(%s_state_t *p, bool r);\n",
+            flo->class_name().c_str(), flo->class_name().c_str());
+    fprintf(f, "};\n");
+
+    fprintf(f, "%svoid %s_t::clock(bool r)\n", inl, flo->class_name().c_str());
+    fprintf(f, "  { clock_lo(r); clock_hi(r); }\n");
+
+    fprintf(f, "%svoid %s_t::clock_lo(bool r)\n", inl, flo->class_name().c_str());
+    if (parts.threads() > 1) {
+        fprintf(f, "  { pool.clock_lo(&state, r); }\n");
+    } else {
+        fprintf(f, "  { _llvmflo_%s_clock_lo(&state, r); }\n",
+                flo->class_name().c_str());
+    }
+
+    fprintf(f, "%svoid %s_t::clock_hi(bool r __attribute__((unused)))\n{\n",
+            inl, flo->class_name().c_str());
+    if (layout.regs_words() > 0) {
+        fprintf(f, "  uint64_t *s = (uint64_t *)&state;\n");
+        fprintf(f, "  memcpy(s, s + " SIZET_FORMAT ", " SIZET_FORMAT ");\n",
+                layout.nexts_offset(),
+                layout.regs_words() * sizeof(uint64_t));
+    }
+    fprintf(f, "}\n");
+
+    /* Every lane starts out in exactly the same state. */
+    fprintf(f, "%svoid %s_t::init(void)\n{\n", inl, flo->class_name().c_str());
+    fprintf(f, "  memset(&state, 0, sizeof(state));\n");
+    generate_mem_init(flo, true, f);
+    fprintf(f, "}\n");
+
+    return 0;
+}
+
+void generate_mem_init(const flo_ptr flo, bool lanes, FILE *f)
+{
+    for (const auto& init: mem_inits(flo)) {
+        if (init.second.size() == 0)
+            continue;
+
+        auto words = init.second[0].second.size();
+
+        fprintf(f, "  {\n");
+        fprintf(f, "    static const uint64_t t[" SIZET_FORMAT "][" SIZET_FORMAT "] = {\n",
+                init.second.size(),
+                words + 1);
+        for (const auto& element: init.second) {
+            fprintf(f, "      { " SIZET_FORMAT "ULL", element.first);
+            for (const auto& word: element.second)
+                fprintf(f, ", 0x%016llxULL", (unsigned long long)word);
+            fprintf(f, " },\n");
+        }
+        fprintf(f, "    };\n");
+
+        fprintf(f, "    for (size_t i = 0; i < " SIZET_FORMAT "; ++i)\n",
+                init.second.size());
+        fprintf(f, "      for (size_t w = 0; w < " SIZET_FORMAT "; ++w)\n",
+                words);
+        if (lanes == true) {
+            fprintf(f, "        for (size_t l = 0; l < lanes; ++l)\n");
+            fprintf(f, "          poke_%s(l, t[i][0], t[i][w + 1], w);\n",
+                    init.first.c_str());
+        } else {
+            fprintf(f, "        this->%s.contents[t[i][0]].values[w] = t[i][w + 1];\n",
+                    init.first.c_str());
+        }
+        fprintf(f, "  }\n");
+    }
+}
+
+void generate_pool(const flo_ptr flo, const partitions& parts, FILE *f)
+{
+    auto name = flo->class_name();
+
+    fprintf(f, "#include <atomic>\n");
+    fprintf(f, "#include <condition_variable>\n");
+    fprintf(f, "#include <mutex>\n");
+    fprintf(f, "#include <thread>\n");
+    fprintf(f, "#include <vector>\n");
+
+    fprintf(f, "extern \"C\" {\n");
+    for (size_t s = 0; s < parts.stages(); ++s) {
+        for (size_t t = 0; t < parts.threads(); ++t) {
+            if (parts.at(s, t).empty() == true)
+                continue;
+
+            fprintf(f, "  void %s(%s_state_t *p, bool r);\n",
+                    parts.function_name(flo, s, t).c_str(),
+                    name.c_str());
+        }
+    }
+    fprintf(f, "};\n");
+
+    /* Every thread runs its columns of this table, with a barrier
+     * after each row. */
+    fprintf(f, "static void (*const _llvmflo_%s_stages[" SIZET_FORMAT "][" SIZET_FORMAT "])(%s_state_t *, bool) = {\n",
+            name.c_str(),
+            parts.stages(),
+            parts.threads(),
+            name.c_str());
+    for (size_t s = 0; s < parts.stages(); ++s) {
+        fprintf(f, "  {");
+        for (size_t t = 0; t < parts.threads(); ++t) {
+            fprintf(f, " %s,",
+                    parts.at(s, t).empty()
+                    ? "NULL"
+                    : parts.function_name(flo, s, t).c_str());
+        }
+        fprintf(f, " },\n");
+    }
+    fprintf(f, "};\n");
+
+    /* This is exactly the same as the pool that's used to run designs
+     * in-process, see pool.c++ for how it works. */
+    fprintf(f, "class _llvmflo_%s_pool {\n", name.c_str());
+    fprintf(f, "    std::vector<std::thread> _workers;\n");
+    fprintf(f, "    size_t _threads;\n");
+    fprintf(f, "    std::atomic<size_t> _arrived;\n");
+    fprintf(f, "    std::atomic<size_t> _phase;\n");
+    fprintf(f, "    std::atomic<size_t> _sleeping;\n");
+    fprintf(f, "    std::mutex _lock;\n");
+    fprintf(f, "    std::condition_variable _wake;\n");
+    fprintf(f, "    std::atomic<bool> _stop;\n");
+    fprintf(f, "    %s_state_t *_state;\n", name.c_str());
+    fprintf(f, "    bool _reset;\n");
+    fprintf(f, "  public:\n");
+    fprintf(f, "    _llvmflo_%s_pool(void)\n", name.c_str());
+    fprintf(f, "      : _workers(), _threads(std::thread::hardware_concurrency()), _arrived(0), _phase(0), _sleeping(0), _lock(), _wake(), _stop(false), _state(NULL), _reset(false) {\n");
+    fprintf(f, "      if (_threads == 0 || _threads > " SIZET_FORMAT ") _threads = " SIZET_FORMAT ";\n",
+            parts.threads(),
+            parts.threads());
+    fprintf(f, "      for (size_t t = 1; t < _threads; ++t)\n");
+    fprintf(f, "        _workers.push_back(std::thread(&_llvmflo_%s_pool::work, this, t));\n",
+            name.c_str());
+    fprintf(f, "    }\n");
+
+    /* Copies (as made by clone()) get threads of their own, they
+     * never share them with the original. */
+    fprintf(f, "    _llvmflo_%s_pool(const _llvmflo_%s_pool&)\n",
+            name.c_str(), name.c_str());
+    fprintf(f, "      : _llvmflo_%s_pool() {}\n", name.c_str());
+    fprintf(f, "    _llvmflo_%s_pool& operator=(const _llvmflo_%s_pool&)\n",
+            name.c_str(), name.c_str());
+    fprintf(f, "      { return *this; }\n");
+    fprintf(f, "    ~_llvmflo_%s_pool(void) {\n", name.c_str());
+    fprintf(f, "      _stop.store(true, std::memory_order_relaxed);\n");
+    fprintf(f, "      barrier();\n");
+    fprintf(f, "      for (auto& worker: _workers) worker.join();\n");
+    fprintf(f, "    }\n");
+    fprintf(f, "    void clock_lo(%s_state_t *state, bool reset)\n",
+            name.c_str());
+    fprintf(f, "      { _state = state; _reset = reset; barrier(); run(0); }\n");
+    fprintf(f, "  private:\n");
+    fprintf(f, "    void barrier(void) {\n");
+    fprintf(f, "      size_t phase = _phase.load(std::memory_order_acquire);\n");
+    fprintf(f, "      if (_arrived.fetch_add(1, std::memory_order_acq_rel) + 1 == _threads) {\n");
+    fprintf(f, "        _arrived.store(0, std::memory_order_relaxed);\n");
+    fprintf(f, "        _phase.store(phase + 1);\n");
+    fprintf(f, "        if (_sleeping.load() > 0) {\n");
+    fprintf(f, "          std::lock_guard<std::mutex> lock(_lock);\n");
+    fprintf(f, "          _wake.notify_all();\n");
+    fprintf(f, "        }\n");
+    fprintf(f, "        return;\n");
+    fprintf(f, "      }\n");
+    fprintf(f, "      for (size_t spins = 0; spins < %d; ++spins)\n",
+            POOL_SPINS);
+    fprintf(f, "        if (_phase.load(std::memory_order_acquire) != phase) return;\n");
+    fprintf(f, "      std::unique_lock<std::mutex> lock(_lock);\n");
+    fprintf(f, "      _sleeping.fetch_add(1);\n");
+    fprintf(f, "      while (_phase.load() == phase) _wake.wait(lock);\n");
+    fprintf(f, "      _sleeping.fetch_sub(1);\n");
+    fprintf(f, "    }\n");
+    fprintf(f, "    void run(size_t t) {\n");
+    fprintf(f, "      for (size_t s = 0; s < " SIZET_FORMAT "; ++s) {\n",
+            parts.stages());
+    fprintf(f, "        for (size_t p = t; p < " SIZET_FORMAT "; p += _threads)\n",
+            parts.threads());
+    fprintf(f, "          if (_llvmflo_%s_stages[s][p] != NULL)\n", name.c_str());
+    fprintf(f, "            _llvmflo_%s_stages[s][p](_state, _reset);\n",
+            name.c_str());
+    fprintf(f, "        barrier();\n");
+    fprintf(f, "      }\n");
+    fprintf(f, "    }\n");
+    fprintf(f, "    void work(size_t t) {\n");
+    fprintf(f, "      while (true) {\n");
+    fprintf(f, "        barrier();\n");
+    fprintf(f, "        if (_stop.load(std::memory_order_relaxed) == true) return;\n");
+    fprintf(f, "        run(t);\n");
+    fprintf(f, "      }\n");
+    fprintf(f, "    }\n");
+    fprintf(f, "};\n");
+}
+
+std::string vcd_header(const flo_ptr flo)
+{
+    std::string out;
+
+    out += "$timescale 1ps $end\n";
+    out += "$scope module " + flo->class_name() + " $end\n";
+
+    std::string last_path = "";
+    ssize_t scope = 1;
+    for (const auto& node: flo->nodes_alpha()) {
+        char buffer[BUFFER_SIZE];
+        snprintf(buffer, BUFFER_SIZE, "%s", node->name().c_str());
+
+        /* Here's where we figure out where in the module heirarchy
+         * this node is. */
+        char *module = buffer;
+        char *signal = buffer;
+        for (size_t i = 0; i < strlen(buffer); i++)
+            if (buffer[i] == ':')
+                signal = buffer + i;
+
+        /* These have no "::" in them, which means they're not
+         * globally visible. */
+        if (module == signal)
+            continue;
+
+        /* The module seperator can be either ":" or "::".  Detect
+         * which one is actually generated and demangle the name
+         * correctly. */
+        if (signal[-1] == ':')
+            signal[-1] = '\0';
+        signal[0] = '\0';
+        signal++;
+
+        /* Figure out if we're going up or down a module and perform
+         * that move. */
+        if (strcmp(module, last_path.c_str()) == 0) {
+        } else if (component_start(last_path, module)) {
+            out += "$upscope $end\n";
+            scope--;
+        } else if (component_start(module, last_path)) {
+            /* Determine a slightly shorter name for the module, which
+             * is what VCD uses.  This is just the last component of
+             * the module name, the remainder can be determined by the
+             * hierarchy. */
+            char *lastmodule = module;
+            for (size_t i = 0; i < strlen(module); i++)
+                if (module[i] == ':')
+                    lastmodule = module + i;
+            if (*lastmodule == ':')
+                lastmodule++;
+
+            out += std::string("$scope module ") + lastmodule + " $end\n";
+            scope++;
+        } else {
+            size_t cur_comp  = count_components(node->name());
+            size_t last_comp = count_components(last_path) + 1;
+            for (size_t i = cur_comp; i <= last_comp; ++i) {
+                out += "$upscope $end\n";
+                scope--;
+            }
+
+            /* Determine a slightly shorter name for the module, which
+             * is what VCD uses.  This is just the last component of
+             * the module name, the remainder can be determined by the
+             * hierarchy. */
+            char *lastmodule = module;
+            for (size_t i = 0; i < strlen(module); i++)
+                if (module[i] == ':')
+                    lastmodule = module + i;
+            if (*lastmodule == ':')
+                lastmodule++;
+
+            out += std::string("$scope module ") + lastmodule + " $end\n";
+            scope++;
+        }
+
+        /* After changing modules, go ahead and output the wire. */
+        out += "$var wire " + std::to_string(node->width())
+            + " " + node->vcd_name() + " " + signal + " $end\n";
+
+#ifdef VERBOSE_VCD_FILE
+        out += "$comment '" + node->name() + "' $end\n";
+#endif
+
+        /* The last path is always equal to the current one -- note
+         * that sometimes this won't do anything as it'll be the same,
+         * but this strictly enforces this condition. */
+        last_path = module;
+    }
+
+    for (ssize_t i = 0; i < scope; i++)
+        out += "$upscope $end\n";
+
+    out += "$scope module _chisel_temps_ $end\n";
+
+    for (const auto& node: flo->nodes()) {
+        if (node->vcd_exported() == false)
+            continue;
+
+        if (node->chisel_temp() == false)
+            continue;
+
+        out += "$var wire " + std::to_string(node->width())
+            + " " + node->vcd_name() + " " + node->name() + " $end\n";
+    }
+
+    out += "$upscope $end\n";
+
+    out += "$enddefinitions $end\n";
+    out += "$dumpvars\n";
+    out += "$end\n";
+
+    return out;
+}
+
+std::string c_literal(const std::string str)
+{
+    std::string out = "\"";
+
+    for (size_t i = 0; i < str.size(); ++i) {
+        char c = str[i];
+        unsigned char u = c;
+
+        if (u == '\n' && i + 1 < str.size()) {
+            out += "\\n\"\n  \"";
+        } else if (u == '\n') {
+            out += "\\n";
+        } else if (u == '"' || u == '\\' || u == '?') {
+            out += '\\';
+            out += c;
+        } else if (u >= ' ' && u < 0x7f) {
+            out += c;
+        } else {
+            char buffer[8];
+            snprintf(buffer, 8, "\\%03o", u);
+            out += buffer;
+        }
+    }
+
+    return out + "\"";
+}
+
+size_t dump_buffer_size(const flo_ptr flo, const options& opts)
+{
+    /* Each cycle is formatted into a single buffer that's written out
+     * all at once, this is enough for the cycle number. */
+    size_t buffer_size = 32;
+
+    for (const auto& node: flo->nodes()) {
+        if (node->vcd_exported() == false)
+            continue;
+
+        if (opts.binary_trace() == true) {
+            /* A varint is never longer than 10 bytes. */
+            buffer_size += 10 * (1 + (node->width() + 63) / 64);
+        } else {
+            buffer_size += 4 + node->width() + node->vcd_name().size();
+#ifdef VERBOSE_VCD_FILE
+            buffer_size += 20 + node->name().size();
+#endif
+        }
+    }
+
+    return buffer_size;
+}
+
+void generate_dump(const flo_ptr flo, const options& opts, FILE *f,
+                   bool in_header)
+{
+    auto name = flo->class_name();
+    auto header = vcd_header(flo);
+
+    /* Every signal that ends up in the dump, in the order they're
+     * written. */
+    std::vector<std::shared_ptr<node>> signals;
+    for (const auto& node: flo->nodes())
+        if (node->vcd_exported() == true)
+            signals.push_back(node);
+
+    if (opts.binary_trace() == true) {
+        /* The whole header record is known right now, so it's just
+         * a string constant in the generated code. */
+        std::string record(1, TRACE_HEADER);
+        record += TRACE_MAGIC;
+        trace_put_varint(record, TRACE_VERSION);
+        trace_put_string(record, header);
+        trace_put_varint(record, signals.size());
+        for (const auto& node: signals) {
+            trace_put_varint(record, node->width());
+            trace_put_string(record, node->vcd_name());
+        }
+
+        fprintf(f, "static const char _llvmflo_%s_trace_header[] =\n  %s;\n",
+                name.c_str(),
+                c_literal(record).c_str());
+
+        fprintf(f, "static inline char *_llvmflo_trace_varint(char *p, uint64_t v)\n{\n");
+        fprintf(f, "  while (v >= 0x80) { *p++ = (char)((v & 0x7f) | 0x80); v >>= 7; }\n");
+        fprintf(f, "  *p++ = (char)v;\n");
+        fprintf(f, "  return p;\n");
+        fprintf(f, "}\n");
+    } else {
+        fprintf(f, "static const char _llvmflo_%s_vcd_header[] =\n  %s;\n",
+                name.c_str(),
+                c_literal(header).c_str());
+
+        /* Values are formatted 8 bits at a time from this table. */
+        fprintf(f, "static const char _llvmflo_vcd_bytes[256][9] = {\n");
+        for (size_t i = 0; i < 256; ++i) {
+            fprintf(f, "%s\"", (i % 8 == 0) ? "  " : " ");
+            for (size_t b = 8; b > 0; --b)
+                fprintf(f, "%c", ((i >> (b - 1)) & 1) ? '1' : '0');
+            fprintf(f, "\",%s", (i % 8 == 7) ? "\n" : "");
+        }
+        fprintf(f, "};\n");
+
+        fprintf(f, "static inline char *_llvmflo_vcd_bits(char *p, const uint64_t *v, size_t w)\n{\n");
+        fprintf(f, "  *p++ = 'b';\n");
+        fprintf(f, "  while (w %% 8 != 0) { w--; *p++ = '0' + ((v[w / 64] >> (w %% 64)) & 1); }\n");
+        fprintf(f, "  while (w > 0) { w -= 8; memcpy(p, _llvmflo_vcd_bytes[(v[w / 64] >> (w %% 64)) & 0xff], 8); p += 8; }\n");
+        fprintf(f, "  return p;\n");
+        fprintf(f, "}\n");
+    }
+
+    fprintf(f, "%svoid %s_t::dump(FILE *f, int cycle)\n{\n",
+            in_header ? "inline " : "", name.c_str());
+    fprintf(f, "  char *p = __dump_buffer;\n");
+
+    if (opts.binary_trace() == true) {
+        /* Keyframes are written against zero, which is done by masking
+         * off the previous value. */
+        fprintf(f, "  if (cycle == 0) {\n");
+        fprintf(f, "    fwrite(_llvmflo_%s_trace_header, 1, sizeof(_llvmflo_%s_trace_header) - 1, f);\n",
+                name.c_str(),
+                name.c_str());
+        fprintf(f, "    __trace_records = 0;\n");
+        fprintf(f, "  }\n");
+        fprintf(f, "  bool key = (__trace_records++ %% %d) == 0;\n",
+                TRACE_KEYFRAME_INTERVAL);
+        fprintf(f, "  uint64_t mask = key ? 0 : ~(uint64_t)0;\n");
+        fprintf(f, "  *p++ = key ? '%c' : '%c';\n",
+                TRACE_KEYFRAME,
+                TRACE_CYCLE);
+        fprintf(f, "  p = _llvmflo_trace_varint(p, (unsigned long)cycle);\n");
+        fprintf(f, "  size_t next = 0;\n");
+    } else {
+        fprintf(f, "  if (cycle == 0)\n");
+        fprintf(f, "    fputs(_llvmflo_%s_vcd_header, f);\n",
+                name.c_str());
+        fprintf(f, "  p += sprintf(p, \"#%%lu\\n\", (unsigned long)cycle);\n");
+    }
+
+    /* Rather than comparing entire values, just compare every word
+     * that makes up the value. */
+    for (size_t i = 0; i < signals.size(); ++i) {
+        auto node = signals[i];
+        auto mname = node->mangled_name();
+        size_t words = (node->width() + 63) / 64;
+
+        if (opts.binary_trace() == true) {
+            fprintf(f, "  if (key");
+        } else {
+#ifndef UNCOMPRESSED_VCD
+            fprintf(f, "  if ((cycle == 0)");
+#else
+            fprintf(f, "  if (true");
+#endif
+        }
+
+        for (size_t w = 0; w < words; ++w) {
+            fprintf(f, " | (%s.values[" SIZET_FORMAT "] != %s__prev.values[" SIZET_FORMAT "])",
+                    mname.c_str(), w,
+                    mname.c_str(), w);
+        }
+        fprintf(f, ") {\n");
+
+        if (opts.binary_trace() == true) {
+            fprintf(f, "    p = _llvmflo_trace_varint(p, " SIZET_FORMAT " - next);\n",
+                    i + 1);
+            for (size_t w = 0; w < words; ++w) {
+                fprintf(f, "    p = _llvmflo_trace_varint(p, %s.values[" SIZET_FORMAT "] ^ (%s__prev.values[" SIZET_FORMAT "] & mask));\n",
+                        mname.c_str(), w,
+                        mname.c_str(), w);
+            }
+            fprintf(f, "    next = " SIZET_FORMAT ";\n",
+                    i + 1);
+        } else {
+#ifdef VERBOSE_VCD_FILE
+            auto comment = "$comment '" + node->name() + "' $end\n";
+            fprintf(f, "    memcpy(p, %s, " SIZET_FORMAT "); p += " SIZET_FORMAT ";\n",
+                    c_literal(comment).c_str(),
+                    comment.size(),
+                    comment.size());
+#endif
+
+            auto id = " " + node->vcd_name() + "\n";
+            fprintf(f, "    p = _llvmflo_vcd_bits(p, %s.values, " SIZET_FORMAT ");\n",
+                    mname.c_str(),
+                    node->width());
+            fprintf(f, "    memcpy(p, %s, " SIZET_FORMAT "); p += " SIZET_FORMAT ";\n",
+                    c_literal(id).c_str(),
+                    id.size(),
+                    id.size());
+        }
+
+        fprintf(f, "    %s__prev = %s;\n",
+                mname.c_str(),
+                mname.c_str());
+        fprintf(f, "  }\n");
+    }
+
+    /* A zero ends the list of signals in each binary record. */
+    if (opts.binary_trace() == true)
+        fprintf(f, "  *p++ = 0;\n");
+
+    fprintf(f, "  fwrite(__dump_buffer, 1, p - __dump_buffer, f);\n");
+    fprintf(f, "}\n");
+}
+
+int generate_jit(const flo_ptr flo, const options& opts,
+                 const std::string prefix, timer& t)
+{
+    /* Everything that would usually be generated by a separate
+     * invocation of flo-llvm is instead generated into memory. */
+    char *header = NULL;
+    size_t header_size = 0;
+    FILE *header_file = open_memstream(&header, &header_size);
+    generate_header(flo, opts, header_file);
+
+    /* There's no C++ compiler in here to build the compatibility
+     * layer, so it's instead included in the header.  Everything in
+     * it is inline, so the header can still be included by as many
+     * C++ files as the one from the wrapper. */
+    generate_compat(flo, opts, header_file, true);
+    fclose(header_file);
+    t.phase("header");
+
+    char *ir = NULL;
+    size_t ir_size = 0;
+    FILE *ir_file = open_memstream(&ir, &ir_size);
+    generate_llvmir(flo, opts, ir_file, false);
+    fclose(ir_file);
+    t.phase("llvmir");
+
+    jit j(ir);
+    free(ir);
+    t.phase("ir-parse");
+
+    j.optimize(2);
+    t.phase("optimize");
+
+    if (opts.cycles() == 0) {
+        j.write_object(prefix + ".o");
+        t.phase("codegen");
+
+        FILE *h = fopen((prefix + ".h").c_str(), "w");
+        if (h == NULL) {
+            perror((prefix + ".h").c_str());
+            return 1;
+        }
+        fputs(header, h);
+        fclose(h);
+        free(header);
+
+        t.report(stderr);
+        return 0;
+    }
+    free(header);
+
+    typedef void (*clock_lo_t)(uint64_t *state, bool reset);
+    char clock_lo_name[BUFFER_SIZE];
+    snprintf(clock_lo_name, BUFFER_SIZE, "_llvmflo_%s_clock_lo",
+             flo->class_name().c_str());
+    auto clock_lo = (clock_lo_t)j.function(clock_lo_name);
+
+    /* Partitioned designs are run by a pool of threads, just like
+     * the compatibility layer does it. */
+    partitions parts(flo, opts.threads(), opts.chunk());
+    std::vector<std::vector<pool::func_t>> stages;
+    for (size_t s = 0; s < parts.stages() && parts.threads() > 1; ++s) {
+        stages.push_back(std::vector<pool::func_t>());
+        for (size_t i = 0; i < parts.threads(); ++i) {
+            if (parts.at(s, i).empty() == true) {
+                stages[s].push_back(NULL);
+                continue;
+            }
+
+            auto name = parts.function_name(flo, s, i);
+            stages[s].push_back((pool::func_t)j.function(name));
+        }
+    }
+    t.phase("codegen");
+
+    pool threads(stages, parts.threads());
+
+    /* This mirrors what the compatibility layer does for clock_hi, as
+     * that's just a copy of the register block. */
+    auto layout = layout_state(flo, opts);
+    std::vector<uint64_t> state(layout.words(), 0);
+    if (opts.activity() == true)
+        state[layout.raw_offset("__activity_full")] = 1;
+
+    /* Memories live directly in the state, so their initial contents
+     * can just be copied in. */
+    auto inits = mem_inits(flo);
+    for (const auto& node: flo->nodes()) {
+        if (node->is_mem() == false)
+            continue;
+
+        for (const auto& element: inits[node->mangled_name()]) {
+            auto base = layout.offset(node) + element.first * layout.stride(node);
+            for (size_t w = 0; w < element.second.size(); ++w)
+                for (size_t l = 0; l < layout.lanes(); ++l)
+                    state[base + w * layout.lanes() + l] = element.second[w];
+        }
+    }
+
+    auto clock = [&](bool reset) {
+        if (parts.threads() > 1)
+            threads.clock_lo(state.data(), reset);
+        else
+            clock_lo(state.data(), reset);
+        memcpy(state.data(),
+               state.data() + layout.nexts_offset(),
+               layout.regs_words() * sizeof(uint64_t));
+    };
+
+    clock(true);
+    for (size_t i = 0; i < opts.cycles(); ++i)
+        clock(false);
+    t.phase("run");
+
+    t.report(stderr);
+    fprintf(stderr, "flo-llvm: " SIZET_FORMAT " cycles, %.1f cycles/s\n",
+            opts.cycles(),
+            opts.cycles() / t.last());
+
+    /* Shows how much of the design was actually evaluated, which is
+     * what decides if --activity is worth it. */
+    if (opts.activity() == true) {
+        cones c(flo);
+
+        size_t evaluated = 0;
+        for (size_t i = 0; i < c.size(); ++i)
+            evaluated += state[layout.raw_offset("__activity") + i];
+
+        auto cycles = state[layout.raw_offset("__activity_cycles")];
+        fprintf(stderr, "flo-llvm: " SIZET_FORMAT " cones, %.1f%% evaluated per cycle\n",
+                c.size(),
+                100.0 * evaluated / (c.size() * cycles));
+    }
+
+    /* This is the same report that dump_profile() writes out. */
+    if (opts.profile() == true) {
+        auto profile = layout.raw_offset("__profile");
+        for (int c = 0; c < PROFILE_CLASSES; ++c) {
+            fprintf(stderr, "flo-llvm: profile %s: %lu cycles, %lu ops\n",
+                    profile_class_name((enum profile_class)c),
+                    (unsigned long)state[profile + 2 * c],
+                    (unsigned long)state[profile + 2 * c + 1]);
+        }
+    }
+
+    return 0;
+}
+
+bool strsta(const std::string haystack, const std::string needle)
+{
+    const char *h = haystack.c_str();
+    const char *n = needle.c_str();
+
+    return (strncmp(h, n, strlen(n)) == 0);
+}
+
+void array2int(std::shared_ptr<definition> lo,
+               fix_t d,
+               pointer<builtin<uint64_t>> ptr64,
+               size_t i64cnt)
+{
+    auto ptrs = std::vector<pointer<builtin<uint64_t>>>(i64cnt);
+    for (size_t i = 0; i < i64cnt; i++) {
+        auto index = constant<size_t>(i);
+        lo->operate(index_op(ptrs[i], ptr64, index));
+    }
+
+    auto loads = std::vector<builtin<uint64_t>>(i64cnt);
+    for (size_t i = 0; i < i64cnt; ++i) {
+        lo->operate(load_op(loads[i], ptrs[i]));
+    }
+
+    auto extended = std::vector<fix_t>();
+    for (size_t i = 0; i < i64cnt; ++i) {
+        /* We need this push here because every one of these
+         * temporaries needs a new name which means the copy
+         * constructor can't be used.  The default constructor can't
+         * be used because we need to tag each fix with a width. */
+        extended.push_back(fix_t(d.width()));
+        lo->operate(zext_trunc_op(extended[i], loads[i]));
+    }
+
+    auto shifted = std::vector<fix_t>();
+    for (size_t i = 0; i < i64cnt; i++) {
+        shifted.push_back(fix_t(d.width()));
+        auto offset = constant<uint32_t>(i * 64);
+        lo->operate(lsh_op(shifted[i], extended[i], offset));
+    }
+
+    auto ored = std::vector<fix_t>();
+    for (size_t i = 0; i < i64cnt; ++i) {
+        ored.push_back(fix_t(d.width()));
+        if (i == 0) {
+            lo->operate(mov_op(ored[i], shifted[i]));
+        } else {
+            lo->operate(or_op(ored[i], shifted[i], ored[i-1]));
+        }
+    }
+
+    lo->operate(mov_op(d, ored[i64cnt-1]));
+}
+
+void int2array(std::shared_ptr<definition> lo,
+               fix_t d,
+               pointer<builtin<uint64_t>> ptr64,
+               size_t i64cnt)
+{
+    auto shifted = std::vector<fix_t>();
+    for (size_t i = 0; i < i64cnt; ++i) {
+        shifted.push_back(fix_t(d.width()));
+        auto offset = constant<uint32_t>(i * 64);
+        lo->operate(lrsh_op(shifted[i], d, offset));
+    }
+
+    auto trunced = std::vector<builtin<uint64_t>>(i64cnt);
     for (size_t i = 0; i < i64cnt; ++i) {
         lo->operate(zext_trunc_op(trunced[i], shifted[i]));
     }
@@ -1103,6 +2954,473 @@ void int2array(std::shared_ptr<definition> lo,
     }
 }
 
+void load_state(std::shared_ptr<definition> lo,
+                fix_t d,
+                clock_lo_frame& frame,
+                const state_layout& layout,
+                size_t offset,
+                size_t i64cnt,
+                size_t lanes)
+{
+    auto& state = frame.state;
+
+    if (lanes <= 1) {
+        auto ptr64 = pointer<builtin<uint64_t>>();
+        lo->operate(index_op(ptr64, state,
+                             state_offset(lo, layout, frame, offset)));
+        array2int(lo, d, ptr64, i64cnt);
+        return;
+    }
+
+    /* Each word is stored for every lane before the next word, so
+     * it can be loaded as a single vector. */
+    auto words = std::vector<fix_t>();
+    for (size_t i = 0; i < i64cnt; ++i) {
+        auto ptr64 = pointer<builtin<uint64_t>>();
+        auto index = state_offset(lo, layout, frame, offset + i * lanes);
+        lo->operate(index_op(ptr64, state, index));
+
+        auto ptrv = fix_ptr_t(64);
+        lo->operate(bitcast_op(ptrv, ptr64));
+
+        /* The state is only guaranteed to be aligned to a word,
+         * not to a whole vector. */
+        words.push_back(fix_t(64));
+        lo->operate(load_op(words[i], ptrv, sizeof(uint64_t)));
+    }
+
+    words2vec(lo, d, words);
+}
+
+void store_state(std::shared_ptr<definition> lo,
+                 fix_t d,
+                 clock_lo_frame& frame,
+                 const state_layout& layout,
+                 size_t offset,
+                 size_t i64cnt,
+                 size_t lanes)
+{
+    auto& state = frame.state;
+
+    if (lanes <= 1) {
+        auto ptr64 = pointer<builtin<uint64_t>>();
+        lo->operate(index_op(ptr64, state,
+                             state_offset(lo, layout, frame, offset)));
+        int2array(lo, d, ptr64, i64cnt);
+        return;
+    }
+
+    auto words = vec2words(lo, d, i64cnt);
+    for (size_t i = 0; i < i64cnt; ++i) {
+        auto ptr64 = pointer<builtin<uint64_t>>();
+        auto index = state_offset(lo, layout, frame, offset + i * lanes);
+        lo->operate(index_op(ptr64, state, index));
+
+        auto ptrv = fix_ptr_t(64);
+        lo->operate(bitcast_op(ptrv, ptr64));
+
+        lo->operate(store_op(ptrv, words[i], sizeof(uint64_t)));
+    }
+}
+
+void words2vec(std::shared_ptr<definition> lo,
+               fix_t d,
+               const std::vector<fix_t>& words)
+{
+    auto ored = std::vector<fix_t>();
+    for (size_t i = 0; i < words.size(); ++i) {
+        auto extended = fix_t(d.width());
+        lo->operate(zext_trunc_op(extended, words[i]));
+
+        auto shifted = fix_t(d.width());
+        lo->operate(lsh_op(shifted, extended,
+                           fix_constant(d.width(), i * 64)));
+
+        ored.push_back(fix_t(d.width()));
+        if (i == 0) {
+            lo->operate(mov_op(ored[i], shifted));
+        } else {
+            lo->operate(or_op(ored[i], shifted, ored[i-1]));
+        }
+    }
+
+    lo->operate(mov_op(d, ored[words.size()-1]));
+}
+
+std::vector<fix_t> vec2words(std::shared_ptr<definition> lo,
+                             fix_t d,
+                             size_t i64cnt)
+{
+    auto words = std::vector<fix_t>();
+    for (size_t i = 0; i < i64cnt; ++i) {
+        auto shifted = fix_t(d.width());
+        lo->operate(lrsh_op(shifted, d, fix_constant(d.width(), i * 64)));
+
+        words.push_back(fix_t(64));
+        lo->operate(zext_trunc_op(words[i], shifted));
+    }
+
+    return words;
+}
+
+/* Returns the smallest power of two that can index every element of
+ * a memory, which is what Chisel's mem_t masks indices with. */
+static size_t mem_pow2(const std::shared_ptr<node> mem)
+{
+    size_t pow2 = 1;
+    while (pow2 < mem->depth())
+        pow2 <<= 1;
+    return pow2;
+}
+
+/* Finds the first word of a single lane's element of a memory, along
+ * with whether or not that element is actually in the memory.  This
+ * matches Chisel's mem_t: indices are masked to the next power of two,
+ * and anything past the end of the memory is out of bounds. */
+static void mem_offset(std::shared_ptr<definition> lo,
+                       clock_lo_frame& frame,
+                       const state_layout& layout,
+                       const std::shared_ptr<node> mem,
+                       builtin<uint64_t> index,
+                       size_t lane,
+                       builtin<uint64_t>& offset,
+                       builtin<bool>& valid)
+{
+    size_t pow2 = mem_pow2(mem);
+
+    auto masked = builtin<uint64_t>();
+    lo->operate(and_op<builtin<uint64_t>>(masked, index,
+                                          constant<uint64_t>(pow2 - 1)));
+
+    lo->operate(cmp_lt_op<builtin<bool>, builtin<uint64_t>>(
+                    valid, masked, constant<uint64_t>(mem->depth())));
+
+    /* Out of bounds lanes still need some address to point at, so
+     * they just use the first element. */
+    auto safe = builtin<uint64_t>();
+    lo->operate(mux_op<builtin<bool>, builtin<uint64_t>>(
+                    safe, valid, masked, constant<uint64_t>(0)));
+
+    auto scaled = builtin<uint64_t>();
+    lo->operate(mul_op<builtin<uint64_t>, builtin<uint64_t>>(
+                    scaled, safe, constant<uint64_t>(layout.stride(mem))));
+
+    lo->operate(add_op<builtin<uint64_t>>(
+                    offset, scaled,
+                    state_offset(lo, layout, frame, layout.offset(mem) + lane)));
+}
+
+void mem_read(std::shared_ptr<definition> lo,
+              fix_t d,
+              clock_lo_frame& frame,
+              const state_layout& layout,
+              const std::shared_ptr<node> mem,
+              fix_t index)
+{
+    auto i64cnt = (mem->width() + 63) / 64;
+    auto& state = frame.state;
+
+    auto index64 = builtin<uint64_t>();
+    lo->operate(zext_trunc_op(index64, index));
+
+    auto offset = builtin<uint64_t>();
+    auto valid = builtin<bool>();
+    mem_offset(lo, frame, layout, mem, index64, 0, offset, valid);
+
+    auto ptr64 = pointer<builtin<uint64_t>>();
+    lo->operate(index_op(ptr64, state, offset));
+
+    if (mem_pow2(mem) == mem->depth()) {
+        array2int(lo, d, ptr64, i64cnt);
+        return;
+    }
+
+    /* Reads past the end of the memory return zero. */
+    auto loaded = fix_t(d.width());
+    array2int(lo, loaded, ptr64, i64cnt);
+    lo->operate(mux_op(d, valid, loaded, fix_constant(d.width(), 0)));
+}
+
+void mem_write(std::shared_ptr<definition> lo,
+               clock_lo_frame& frame,
+               const state_layout& layout,
+               const std::shared_ptr<node> mem,
+               fix_t enable,
+               fix_t index,
+               fix_t d)
+{
+    auto i64cnt = (mem->width() + 63) / 64;
+    auto& state = frame.state;
+
+    auto index64 = builtin<uint64_t>();
+    lo->operate(zext_trunc_op(index64, index));
+
+    auto offset = builtin<uint64_t>();
+    auto valid = builtin<bool>();
+    mem_offset(lo, frame, layout, mem, index64, 0, offset, valid);
+
+    auto enabled = builtin<bool>();
+    lo->operate(unsafemov_op(enabled, enable));
+
+    /* Writes past the end of the memory are dropped, just like
+     * Chisel's mem_t::put() does. */
+    auto write = builtin<bool>();
+    lo->operate(and_op<builtin<bool>>(write, enabled, valid));
+
+    /* Unlike with lanes there's only a single write here, so it's
+     * cheaper to branch around it than to read the old value. */
+    label write_label, done_label;
+    lo->operate(br_op(write, write_label, done_label));
+    lo->operate(label_op(write_label));
+
+    auto ptr64 = pointer<builtin<uint64_t>>();
+    lo->operate(index_op(ptr64, state, offset));
+    int2array(lo, d, ptr64, i64cnt);
+
+    lo->operate(br_op(done_label));
+    lo->operate(label_op(done_label));
+}
+
+void mem_read_lanes(std::shared_ptr<definition> lo,
+                    fix_t d,
+                    clock_lo_frame& frame,
+                    const state_layout& layout,
+                    const std::shared_ptr<node> mem,
+                    fix_t index)
+{
+    auto i64cnt = (mem->width() + 63) / 64;
+    auto& state = frame.state;
+
+    auto index64 = fix_t(64);
+    lo->operate(zext_trunc_op(index64, index));
+
+    /* There's no gather in LLVM's IR, so every lane's element gets
+     * loaded on its own and then inserted into the vector. */
+    auto gathered = std::vector<std::vector<fix_t>>(i64cnt);
+    for (size_t l = 0; l < layout.lanes(); ++l) {
+        auto offset = builtin<uint64_t>();
+        auto valid = builtin<bool>();
+        auto index = builtin<uint64_t>();
+        lo->operate(extractelement_op(index, index64, l));
+
+        mem_offset(lo, frame, layout, mem, index, l, offset, valid);
+
+        for (size_t i = 0; i < i64cnt; ++i) {
+            auto addr = builtin<uint64_t>();
+            lo->operate(add_op<builtin<uint64_t>>(
+                            addr, offset,
+                            constant<uint64_t>(i * layout.lanes())));
+
+            auto ptr64 = pointer<builtin<uint64_t>>();
+            lo->operate(index_op(ptr64, state, addr));
+
+            auto loaded = builtin<uint64_t>();
+            lo->operate(load_op(loaded, ptr64));
+
+            /* Reads past the end of the memory return zero. */
+            auto value = builtin<uint64_t>();
+            lo->operate(mux_op<builtin<bool>, builtin<uint64_t>>(
+                            value, valid, loaded, constant<uint64_t>(0)));
+
+            gathered[i].push_back(fix_t(64));
+            if (l == 0) {
+                lo->operate(insertelement_op(gathered[i][l], value, l));
+            } else {
+                lo->operate(insertelement_op(gathered[i][l],
+                                             gathered[i][l-1],
+                                             value, l));
+            }
+        }
+    }
+
+    auto words = std::vector<fix_t>();
+    for (size_t i = 0; i < i64cnt; ++i)
+        words.push_back(gathered[i][layout.lanes()-1]);
+
+    words2vec(lo, d, words);
+}
+
+void mem_write_lanes(std::shared_ptr<definition> lo,
+                     clock_lo_frame& frame,
+                     const state_layout& layout,
+                     const std::shared_ptr<node> mem,
+                     fix_t enable,
+                     fix_t index,
+                     fix_t d)
+{
+    auto i64cnt = (mem->width() + 63) / 64;
+    auto& state = frame.state;
+
+    auto index64 = fix_t(64);
+    lo->operate(zext_trunc_op(index64, index));
+
+    auto words = vec2words(lo, d, i64cnt);
+
+    /* Like reads, every lane's write is scattered on its own.  Each
+     * one is a read-modify-write so lanes that aren't writing don't
+     * need any control flow. */
+    for (size_t l = 0; l < layout.lanes(); ++l) {
+        auto offset = builtin<uint64_t>();
+        auto valid = builtin<bool>();
+        auto index = builtin<uint64_t>();
+        lo->operate(extractelement_op(index, index64, l));
+
+        mem_offset(lo, frame, layout, mem, index, l, offset, valid);
+
+        auto lane_enable = builtin<bool>();
+        lo->operate(extractelement_op(lane_enable, enable, l));
+
+        auto write = builtin<bool>();
+        lo->operate(and_op<builtin<bool>>(write, lane_enable, valid));
+
+        for (size_t i = 0; i < i64cnt; ++i) {
+            auto addr = builtin<uint64_t>();
+            lo->operate(add_op<builtin<uint64_t>>(
+                            addr, offset,
+                            constant<uint64_t>(i * layout.lanes())));
+
+            auto ptr64 = pointer<builtin<uint64_t>>();
+            lo->operate(index_op(ptr64, state, addr));
+
+            auto old_value = builtin<uint64_t>();
+            lo->operate(load_op(old_value, ptr64));
+
+            auto new_value = builtin<uint64_t>();
+            lo->operate(extractelement_op(new_value, words[i], l));
+
+            auto value = builtin<uint64_t>();
+            lo->operate(mux_op(value, write, new_value, old_value));
+
+            lo->operate(store_op(ptr64, value));
+        }
+    }
+}
+
+std::map<std::string, mem_init_t> mem_inits(const flo_ptr flo)
+{
+    std::map<std::string, mem_init_t> out;
+
+    for (const auto& op: flo->operations()) {
+        if (op->op() != libflo::opcode::INIT)
+            continue;
+
+        auto mem = op->s();
+        auto words = (mem->width() + 63) / 64;
+        auto index = constant_words(op->t()->name(), 1)[0];
+
+        index &= mem_pow2(mem) - 1;
+        if (index >= mem->depth())
+            continue;
+
+        out[mem->mangled_name()].push_back(
+            std::make_pair(index, constant_words(op->u()->name(), words)));
+    }
+
+    return out;
+}
+
+std::vector<uint64_t> constant_words(const std::string str, size_t words)
+{
+    unsigned base = 10;
+    size_t start = 0;
+    if (str.size() > 2 && str[0] == '0' && (str[1] == 'x' || str[1] == 'X')) {
+        base = 16;
+        start = 2;
+    }
+
+    /* The constant is accumulated in 32-bit halves so that every
+     * multiply-add fits in a 64-bit word. */
+    std::vector<uint64_t> halves(words * 2, 0);
+    for (size_t i = start; i < str.size(); ++i) {
+        char c = tolower(str[i]);
+        uint64_t digit;
+        if (c >= '0' && c <= '9')
+            digit = c - '0';
+        else if (base == 16 && c >= 'a' && c <= 'f')
+            digit = c - 'a' + 10;
+        else {
+            fprintf(stderr, "Unable to parse constant '%s'\n", str.c_str());
+            abort();
+        }
+
+        uint64_t carry = digit;
+        for (auto& half: halves) {
+            uint64_t v = half * base + carry;
+            half = v & 0xFFFFFFFFULL;
+            carry = v >> 32;
+        }
+    }
+
+    std::vector<uint64_t> out(words);
+    for (size_t i = 0; i < words; ++i)
+        out[i] = halves[2*i] | (halves[2*i + 1] << 32);
+    return out;
+}
+
+fix_t fix_constant(size_t width, uint64_t value)
+{
+    if (width < 64)
+        value &= (1ULL << width) - 1;
+
+    return fix_t(width, std::to_string(value));
+}
+
+enum profile_class profile_class_of(libflo::opcode op)
+{
+    switch (op) {
+    case libflo::opcode::ADD:
+    case libflo::opcode::SUB:
+    case libflo::opcode::NEG:
+    case libflo::opcode::MUL:
+    case libflo::opcode::DIV:
+    case libflo::opcode::LOG2:
+        return PROFILE_ARITH;
+
+    case libflo::opcode::CAT:
+    case libflo::opcode::CATD:
+    case libflo::opcode::LSH:
+    case libflo::opcode::RSH:
+    case libflo::opcode::RSHD:
+    case libflo::opcode::ARSH:
+        return PROFILE_BITS;
+
+    case libflo::opcode::RD:
+    case libflo::opcode::WR:
+    case libflo::opcode::INIT:
+    case libflo::opcode::MEM:
+        return PROFILE_MEM;
+
+    case libflo::opcode::IN:
+    case libflo::opcode::REG:
+        return PROFILE_READ;
+
+    default:
+        return PROFILE_LOGIC;
+    }
+}
+
+const char *profile_class_name(enum profile_class c)
+{
+    switch (c) {
+    case PROFILE_LOGIC:
+        return "logic";
+    case PROFILE_ARITH:
+        return "arith";
+    case PROFILE_BITS:
+        return "bits";
+    case PROFILE_MEM:
+        return "mem";
+    case PROFILE_READ:
+        return "read";
+    case PROFILE_WRITE:
+        return "write";
+    case PROFILE_CLASSES:
+        break;
+    }
+
+    return "?";
+}
+
 size_t count_components(const std::string str)
 {
     char buffer[LINE_MAX];
@@ -21,6 +21,8 @@
 
 #include "node.h++"
 #include <libflo/sizet_printf.h++>
+#include <ctype.h>
+#include <stdint.h>
 
 #ifndef LINE_MAX
 #define LINE_MAX 1024
@@ -51,7 +53,8 @@ node::node(const std::string name,
 #else
 #error "Decide how many nodes to export!"
 #endif
-      _vcd_name(gen_vcd_name())
+      _vcd_name(gen_vcd_name()),
+      _live_width((size_t)-1)
 {
 }
 
@@ -70,6 +73,42 @@ const std::string node::mangled_name(void) const
     return buffer;
 }
 
+bool node::const_value(uint64_t& value) const
+{
+    if (is_const() == false || known_width() == false)
+        return false;
+
+    auto str = name();
+    unsigned base = 10;
+    size_t start = 0;
+    if (str.size() > 2 && str[0] == '0' && (str[1] == 'x' || str[1] == 'X')) {
+        base = 16;
+        start = 2;
+    }
+    if (start == str.size())
+        return false;
+
+    value = 0;
+    for (size_t i = start; i < str.size(); ++i) {
+        char c = tolower(str[i]);
+        uint64_t digit;
+        if (c >= '0' && c <= '9')
+            digit = c - '0';
+        else if (base == 16 && c >= 'a' && c <= 'f')
+            digit = c - 'a' + 10;
+        else
+            return false;
+
+        if (value > (UINT64_MAX - digit) / base)
+            return false;
+        value = value * base + digit;
+    }
+
+    if (width() < 64)
+        value &= (1ULL << width()) - 1;
+    return true;
+}
+
 const std::string node::chisel_name(void) const
 {
     char buffer[LINE_MAX];
@@ -38,6 +38,7 @@ private:
     bool _vcd_exported;
 
     const std::string _vcd_name;
+    size_t _live_width;
 
 public:
         node(const std::string name,
@@ -74,6 +75,15 @@ public:
      * this node is expected to have when inside the VCD file. */
     const std::string vcd_name(void) const { return _vcd_name; }
 
+    /* Returns TRUE if this node is a constant whose value fits in a
+     * single word, along with that value. */
+    bool const_value(uint64_t& value) const;
+
+    /* Returns the number of low-order bits of this node that can
+     * ever be non-zero, which is never more than its width. */
+    size_t live_width(void) const
+        { return (_live_width < width()) ? _live_width : width(); }
+
     /* Returns the LLVM name of this node, which refers to the name
      * this node is expected to have when inside an LLVM IR file. */
     const std::string llvm_name(void) const;
@@ -122,6 +132,10 @@ public:
     void force_export(void) { _exported = true; }
     void force_vcd_export(void) { _vcd_exported = true; }
     void skip_vcd_export(void) { _vcd_exported = false; }
+
+    /* Records that only the low bits of this node can be set, which
+     * is found by the optimization passes. */
+    void set_live_width(size_t w) { _live_width = w; }
 };
 
 #endif
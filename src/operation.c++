@@ -92,3 +92,144 @@ operation::operation(std::shared_ptr<node>& dest,
         break;
     }
 }
+
+std::shared_ptr<operation> operation::make(std::shared_ptr<node> dest,
+                                           size_t width,
+                                           const libflo::opcode& op,
+                                           const std::vector<std::shared_ptr<node>>& s)
+{
+    return std::shared_ptr<operation>(new operation(dest, width, op, s));
+}
+
+std::vector<std::shared_ptr<node>> operation::sources(void) const
+{
+    std::vector<std::shared_ptr<node>> out;
+
+    switch (op()) {
+    case libflo::opcode::IN:
+    case libflo::opcode::INIT:
+    case libflo::opcode::REG:
+    case libflo::opcode::RST:
+        break;
+
+    case libflo::opcode::LOG2:
+    case libflo::opcode::MOV:
+    case libflo::opcode::NEG:
+    case libflo::opcode::NOT:
+    case libflo::opcode::OUT:
+        out.push_back(s());
+        break;
+
+    case libflo::opcode::ADD:
+    case libflo::opcode::AND:
+    case libflo::opcode::ARSH:
+    case libflo::opcode::CAT:
+    case libflo::opcode::CATD:
+    case libflo::opcode::DIV:
+    case libflo::opcode::EQ:
+    case libflo::opcode::GTE:
+    case libflo::opcode::LSH:
+    case libflo::opcode::LT:
+    case libflo::opcode::MUL:
+    case libflo::opcode::NEQ:
+    case libflo::opcode::OR:
+    case libflo::opcode::RSH:
+    case libflo::opcode::RSHD:
+    case libflo::opcode::SUB:
+    case libflo::opcode::XOR:
+        out.push_back(s());
+        out.push_back(t());
+        break;
+
+    case libflo::opcode::MUX:
+        out.push_back(s());
+        out.push_back(t());
+        out.push_back(u());
+        break;
+
+    case libflo::opcode::RD:
+        out.push_back(u());
+        break;
+
+    case libflo::opcode::WR:
+        out.push_back(s());
+        out.push_back(u());
+        out.push_back(v());
+        break;
+
+    case libflo::opcode::EAT:
+    case libflo::opcode::LD:
+    case libflo::opcode::LIT:
+    case libflo::opcode::MEM:
+    case libflo::opcode::MSK:
+    case libflo::opcode::NOP:
+    case libflo::opcode::RND:
+    case libflo::opcode::ST:
+        break;
+    }
+
+    return out;
+}
+
+std::vector<std::shared_ptr<node>> operation::operands(void) const
+{
+    size_t count = 0;
+
+    switch (op()) {
+    case libflo::opcode::IN:
+    case libflo::opcode::RST:
+    case libflo::opcode::EAT:
+    case libflo::opcode::LD:
+    case libflo::opcode::LIT:
+    case libflo::opcode::MEM:
+    case libflo::opcode::MSK:
+    case libflo::opcode::NOP:
+    case libflo::opcode::RND:
+    case libflo::opcode::ST:
+        break;
+
+    case libflo::opcode::LOG2:
+    case libflo::opcode::MOV:
+    case libflo::opcode::NEG:
+    case libflo::opcode::NOT:
+    case libflo::opcode::OUT:
+        count = 1;
+        break;
+
+    case libflo::opcode::ADD:
+    case libflo::opcode::AND:
+    case libflo::opcode::ARSH:
+    case libflo::opcode::CAT:
+    case libflo::opcode::CATD:
+    case libflo::opcode::DIV:
+    case libflo::opcode::EQ:
+    case libflo::opcode::GTE:
+    case libflo::opcode::LSH:
+    case libflo::opcode::LT:
+    case libflo::opcode::MUL:
+    case libflo::opcode::NEQ:
+    case libflo::opcode::OR:
+    case libflo::opcode::REG:
+    case libflo::opcode::RSH:
+    case libflo::opcode::RSHD:
+    case libflo::opcode::SUB:
+    case libflo::opcode::XOR:
+        count = 2;
+        break;
+
+    case libflo::opcode::INIT:
+    case libflo::opcode::MUX:
+    case libflo::opcode::RD:
+        count = 3;
+        break;
+
+    case libflo::opcode::WR:
+        count = 4;
+        break;
+    }
+
+    std::vector<std::shared_ptr<node>> out;
+    for (size_t i = 0; i < count; ++i)
+        out.push_back(s(i));
+    return out;
+}
@@ -25,6 +25,7 @@
 #include "node.h++"
 #include <libflo/operation.h++>
 #include <libcodegen/fix.h++>
+#include <vector>
 
 class operation: public libflo::operation<node> {
     friend class libflo::operation<node>;
@@ -35,6 +36,14 @@ private:
               const libflo::opcode& op,
               const std::vector<std::shared_ptr<node>>& s);
 
+public:
+    /* Creates a new operation, which is how the optimization passes
+     * rewrite the graph. */
+    static std::shared_ptr<operation> make(std::shared_ptr<node> dest,
+                                           size_t width,
+                                           const libflo::opcode& op,
+                                           const std::vector<std::shared_ptr<node>>& s);
+
 public:
     /* A bunch of different mechanisms for refering to the codegen
      * names of this operation. */
@@ -49,6 +58,16 @@ public:
     /* Returns TRUE if this node should be written back to persistant
      * state. */
     bool writeback(void) const { return d()->exported(); }
+
+    /* Returns the nodes whose values are read when this operation is
+     * computed.  Memories aren't included, and neither is the next
+     * value of a register as that's only used at the end of a
+     * cycle. */
+    std::vector<std::shared_ptr<node>> sources(void) const;
+
+    /* Returns every node that this operation refers to, in order,
+     * including memories and the next value of a register. */
+    std::vector<std::shared_ptr<node>> operands(void) const;
 };
 
 #endif
@@ -0,0 +1,689 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of flo-llvm.
+ *
+ * flo-llvm is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * flo-llvm is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with flo-llvm.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "optimize.h++"
+#include <libflo/sizet_printf.h++>
+#include <algorithm>
+#include <stdint.h>
+#include <stdlib.h>
+
+/* Maps a node that's been removed to the node that replaces it. */
+typedef std::map<const node *, std::shared_ptr<node>> subst_t;
+
+/* Returns TRUE if an operation only computes its result, so it can be
+ * removed or replaced by something else that computes the same
+ * value. */
+static bool pure(const libflo::opcode op);
+
+/* Returns TRUE if a node can be seen outside of clock_lo, which means
+ * it can't be removed. */
+static bool pinned(const std::shared_ptr<node> n);
+
+/* Creates a new constant node. */
+static std::shared_ptr<node> make_constant(size_t width, uint64_t value);
+
+/* Computes the result of an operation whose operands are all
+ * constants, returning FALSE if that's not possible. */
+static bool fold(const std::shared_ptr<operation> op, uint64_t& out);
+
+/* Returns the operand that an operation just copies (like adding
+ * zero), or NULL if it doesn't. */
+static std::shared_ptr<node> identity(const std::shared_ptr<operation> op);
+
+/* Returns a copy of an operation that uses the replacement of every
+ * operand that's been removed. */
+static std::shared_ptr<operation> substitute(const std::shared_ptr<operation> op,
+                                             const subst_t& subst);
+
+/* Names an operation's result such that two operations with the same
+ * key always compute the same value. */
+static std::string cse_key(const std::shared_ptr<operation> op);
+
+/* Returns a mask of the low "width" bits. */
+static uint64_t mask(size_t width);
+
+/* Returns the number of bits that are needed to store a value. */
+static size_t bit_length(uint64_t value);
+
+optimizer::pass::pass(const std::string name,
+                      size_t ops_before, size_t nodes_before,
+                      size_t ops_after, size_t nodes_after)
+    : _name(name),
+      _ops_before(ops_before),
+      _nodes_before(nodes_before),
+      _ops_after(ops_after),
+      _nodes_after(nodes_after)
+{
+}
+
+optimizer::optimizer(const flo_ptr flo)
+    : _nodes(),
+      _ops(),
+      _passes(),
+      _narrowed(0)
+{
+    for (const auto& n: flo->nodes())
+        _nodes[n->name()] = n;
+    for (const auto& op: flo->operations())
+        _ops.push_back(op);
+
+    /* Folding constants makes more operations look the same, and
+     * both of those leave behind copies.  Narrowing can turn some
+     * nodes into constants, so those are folded again before
+     * everything that's no longer used is removed. */
+    run("constprop", &optimizer::constprop);
+    run("cse", &optimizer::cse);
+    run("coalesce", &optimizer::coalesce);
+    run("narrow", &optimizer::narrow);
+    run("constprop", &optimizer::constprop);
+    run("dce", &optimizer::dce);
+}
+
+flo_ptr optimizer::result(void) const
+{
+    auto nodes = _nodes;
+    auto ops = _ops;
+    return std::make_shared<flo>(nodes, ops);
+}
+
+void optimizer::report(FILE *f) const
+{
+    for (const auto& p: _passes) {
+        fprintf(f, "flo-llvm: %-12s " SIZET_FORMAT " ops, " SIZET_FORMAT " nodes -> "
+                SIZET_FORMAT " ops, " SIZET_FORMAT " nodes\n",
+                p.name().c_str(),
+                p.ops_before(), p.nodes_before(),
+                p.ops_after(), p.nodes_after());
+    }
+
+    fprintf(f, "flo-llvm: %-12s " SIZET_FORMAT " ops narrowed to a word\n",
+            "narrow", _narrowed);
+}
+
+void optimizer::constprop(void)
+{
+    subst_t subst;
+    std::vector<std::shared_ptr<operation>> out;
+
+    for (const auto& original: _ops) {
+        auto op = substitute(original, subst);
+        auto d = op->d();
+
+        if (pure(op->op()) == false) {
+            out.push_back(op);
+            continue;
+        }
+
+        /* The replacement for a node always has its width, which is
+         * what every later use of it expects. */
+        std::shared_ptr<node> replacement = NULL;
+        uint64_t value;
+        if (d->width() <= 64 && fold(op, value) == true)
+            replacement = make_constant(d->width(), value);
+        else
+            replacement = identity(op);
+
+        if (replacement == NULL) {
+            out.push_back(op);
+            continue;
+        }
+
+        if (pinned(d) == false) {
+            subst[d.get()] = replacement;
+            continue;
+        }
+
+        if (op->op() == libflo::opcode::MOV)
+            out.push_back(op);
+        else
+            out.push_back(operation::make(d, d->width(),
+                                          libflo::opcode::MOV,
+                                          {replacement}));
+    }
+
+    _ops = out;
+}
+
+void optimizer::cse(void)
+{
+    subst_t subst;
+    std::map<std::string, std::shared_ptr<node>> computed;
+    std::vector<std::shared_ptr<operation>> out;
+
+    for (const auto& original: _ops) {
+        auto op = substitute(original, subst);
+        auto d = op->d();
+
+        /* Reads depend on the writes before them, so they can't be
+         * merged without knowing the memory hasn't changed. */
+        if (pure(op->op()) == false || op->op() == libflo::opcode::RD) {
+            out.push_back(op);
+            continue;
+        }
+
+        auto key = cse_key(op);
+        auto l = computed.find(key);
+        if (l == computed.end()) {
+            computed[key] = d;
+            out.push_back(op);
+            continue;
+        }
+
+        if (pinned(d) == true) {
+            out.push_back(op);
+            continue;
+        }
+
+        subst[d.get()] = l->second;
+    }
+
+    _ops = out;
+}
+
+void optimizer::coalesce(void)
+{
+    std::map<const node *, size_t> uses;
+    for (const auto& op: _ops)
+        for (const auto& n: op->operands())
+            uses[n.get()]++;
+
+    subst_t subst;
+    std::map<const node *, size_t> defined;
+    std::vector<std::shared_ptr<operation>> out;
+
+    for (const auto& original: _ops) {
+        auto op = substitute(original, subst);
+        auto d = op->d();
+
+        bool copy = (op->op() == libflo::opcode::MOV
+                     || op->op() == libflo::opcode::OUT);
+        auto s = copy ? op->s() : std::shared_ptr<node>();
+
+        /* Copies between temporaries just go away, which moves every
+         * use of the copy over to its source. */
+        if (copy == true && pinned(d) == false
+            && s->width() == d->width()) {
+            subst[d.get()] = s;
+            uses[s.get()] += uses[d.get()] - 1;
+            continue;
+        }
+
+        /* A temporary that's only computed to be copied somewhere
+         * else can be computed right where it's going, as nothing
+         * can read the destination before the copy. */
+        auto l = copy ? defined.find(s.get()) : defined.end();
+        if (l != defined.end() && pinned(s) == false
+            && uses[s.get()] == 1 && s->width() == d->width()) {
+            auto index = l->second;
+            auto producer = out[index];
+            out[index] = operation::make(d, producer->width(),
+                                         producer->op(),
+                                         producer->operands());
+            defined.erase(l);
+            defined[d.get()] = index;
+            continue;
+        }
+
+        if (pure(op->op()) == true)
+            defined[d.get()] = out.size();
+        out.push_back(op);
+    }
+
+    _ops = out;
+}
+
+void optimizer::narrow(void)
+{
+    auto live = [](const std::shared_ptr<node> n) -> size_t
+        {
+            uint64_t value;
+            if (n->const_value(value) == true)
+                return std::min(bit_length(value), (size_t)n->width());
+            return n->live_width();
+        };
+
+    subst_t subst;
+    std::vector<std::shared_ptr<operation>> out;
+
+    for (const auto& original: _ops) {
+        auto op = substitute(original, subst);
+        auto d = op->d();
+
+        if (pure(op->op()) == false) {
+            out.push_back(op);
+            continue;
+        }
+
+        size_t w = d->width();
+        uint64_t shift;
+        switch (op->op()) {
+        case libflo::opcode::AND:
+            w = std::min(live(op->s()), live(op->t()));
+            break;
+
+        case libflo::opcode::OR:
+        case libflo::opcode::XOR:
+            w = std::max(live(op->s()), live(op->t()));
+            break;
+
+        case libflo::opcode::ADD:
+            w = std::max(live(op->s()), live(op->t())) + 1;
+            break;
+
+        case libflo::opcode::MUL:
+            w = live(op->s()) + live(op->t());
+            break;
+
+        case libflo::opcode::DIV:
+            w = live(op->s());
+            break;
+
+        case libflo::opcode::CAT:
+        case libflo::opcode::CATD:
+            if (live(op->s()) == 0)
+                w = live(op->t());
+            else
+                w = op->width() + live(op->s());
+            break;
+
+        case libflo::opcode::LSH:
+            if (op->t()->const_value(shift) == true && shift < d->width())
+                w = live(op->s()) + shift;
+            break;
+
+        case libflo::opcode::RSH:
+        case libflo::opcode::RSHD:
+            if (op->t()->const_value(shift) == true)
+                w = (live(op->s()) > shift) ? live(op->s()) - shift : 0;
+            break;
+
+        case libflo::opcode::MUX:
+            w = std::max(live(op->t()), live(op->u()));
+            break;
+
+        case libflo::opcode::EQ:
+        case libflo::opcode::NEQ:
+        case libflo::opcode::LT:
+        case libflo::opcode::GTE:
+            w = 1;
+            break;
+
+        case libflo::opcode::LOG2:
+            w = bit_length(op->s()->width() - 1);
+            break;
+
+        case libflo::opcode::MOV:
+            w = live(op->s());
+            break;
+
+        default:
+            break;
+        }
+
+        d->set_live_width(w);
+
+        if (d->live_width() == 0 && op->op() != libflo::opcode::MOV) {
+            auto zero = make_constant(d->width(), 0);
+            if (pinned(d) == false) {
+                subst[d.get()] = zero;
+                continue;
+            }
+
+            op = operation::make(d, d->width(), libflo::opcode::MOV, {zero});
+        }
+
+        /* These are the operations that are emitted in a single word
+         * when their operands and result all fit. */
+        switch (op->op()) {
+        case libflo::opcode::ADD:
+        case libflo::opcode::AND:
+        case libflo::opcode::MUL:
+        case libflo::opcode::OR:
+        case libflo::opcode::XOR:
+            if (d->width() > 64 && d->live_width() <= 64
+                && live(op->s()) <= 64 && live(op->t()) <= 64) {
+                op->s()->set_live_width(live(op->s()));
+                op->t()->set_live_width(live(op->t()));
+                _narrowed++;
+            }
+            break;
+
+        default:
+            break;
+        }
+
+        out.push_back(op);
+    }
+
+    _ops = out;
+}
+
+void optimizer::dce(void)
+{
+    std::map<const node *, size_t> uses;
+    for (const auto& op: _ops)
+        for (const auto& n: op->operands())
+            uses[n.get()]++;
+
+    /* Going backwards means everything that's only used by a dead
+     * operation is already dead by the time it's reached. */
+    std::vector<std::shared_ptr<operation>> out;
+    std::map<const node *, bool> defined;
+    for (auto it = _ops.rbegin(); it != _ops.rend(); ++it) {
+        auto op = *it;
+        auto d = op->d();
+
+        if (pure(op->op()) == true && pinned(d) == false
+            && uses[d.get()] == 0) {
+            for (const auto& n: op->operands())
+                uses[n.get()]--;
+            continue;
+        }
+
+        defined[d.get()] = true;
+        out.push_back(op);
+    }
+    std::reverse(out.begin(), out.end());
+    _ops = out;
+
+    std::map<std::string, std::shared_ptr<node>> nodes;
+    for (const auto& pair: _nodes) {
+        auto n = pair.second;
+        if (pinned(n) == true || defined[n.get()] || uses[n.get()] > 0)
+            nodes[pair.first] = n;
+    }
+    _nodes = nodes;
+}
+
+void optimizer::run(const std::string name, void (optimizer::*f)(void))
+{
+    auto ops_before = _ops.size();
+    auto nodes_before = live_nodes();
+
+    (this->*f)();
+
+    _passes.push_back(pass(name, ops_before, nodes_before,
+                           _ops.size(), live_nodes()));
+}
+
+size_t optimizer::live_nodes(void) const
+{
+    std::map<const node *, bool> live;
+    for (const auto& op: _ops) {
+        live[op->d().get()] = true;
+        for (const auto& n: op->operands())
+            live[n.get()] = true;
+    }
+
+    size_t out = 0;
+    for (const auto& pair: _nodes)
+        if (pinned(pair.second) == true || live[pair.second.get()])
+            out++;
+    return out;
+}
+
+bool pure(const libflo::opcode op)
+{
+    switch (op) {
+    case libflo::opcode::ADD:
+    case libflo::opcode::AND:
+    case libflo::opcode::ARSH:
+    case libflo::opcode::CAT:
+    case libflo::opcode::CATD:
+    case libflo::opcode::DIV:
+    case libflo::opcode::EQ:
+    case libflo::opcode::GTE:
+    case libflo::opcode::LOG2:
+    case libflo::opcode::LSH:
+    case libflo::opcode::LT:
+    case libflo::opcode::MOV:
+    case libflo::opcode::MUL:
+    case libflo::opcode::MUX:
+    case libflo::opcode::NEG:
+    case libflo::opcode::NEQ:
+    case libflo::opcode::NOT:
+    case libflo::opcode::OR:
+    case libflo::opcode::RD:
+    case libflo::opcode::RSH:
+    case libflo::opcode::RSHD:
+    case libflo::opcode::SUB:
+    case libflo::opcode::XOR:
+        return true;
+
+    case libflo::opcode::EAT:
+    case libflo::opcode::IN:
+    case libflo::opcode::INIT:
+    case libflo::opcode::LD:
+    case libflo::opcode::LIT:
+    case libflo::opcode::MEM:
+    case libflo::opcode::MSK:
+    case libflo::opcode::NOP:
+    case libflo::opcode::OUT:
+    case libflo::opcode::REG:
+    case libflo::opcode::RND:
+    case libflo::opcode::RST:
+    case libflo::opcode::ST:
+    case libflo::opcode::WR:
+        return false;
+    }
+
+    return false;
+}
+
+bool pinned(const std::shared_ptr<node> n)
+{
+    return n->exported() || n->vcd_exported() || n->is_mem();
+}
+
+std::shared_ptr<node> make_constant(size_t width, uint64_t value)
+{
+    return std::make_shared<node>(std::to_string(value & mask(width)),
+                                  libflo::unknown<size_t>(width),
+                                  libflo::unknown<size_t>(0),
+                                  false,
+                                  true,
+                                  libflo::unknown<size_t>(),
+                                  libflo::unknown<std::string>());
+}
+
+bool fold(const std::shared_ptr<operation> op, uint64_t& out)
+{
+    std::vector<uint64_t> v;
+    for (const auto& n: op->operands()) {
+        uint64_t value;
+        if (n->const_value(value) == false)
+            return false;
+        v.push_back(value);
+    }
+
+    auto d = op->d();
+    uint64_t sign;
+    switch (op->op()) {
+    case libflo::opcode::ADD:  out = v[0] + v[1]; break;
+    case libflo::opcode::SUB:  out = v[0] - v[1]; break;
+    case libflo::opcode::MUL:  out = v[0] * v[1]; break;
+    case libflo::opcode::AND:  out = v[0] & v[1]; break;
+    case libflo::opcode::OR:   out = v[0] | v[1]; break;
+    case libflo::opcode::XOR:  out = v[0] ^ v[1]; break;
+    case libflo::opcode::NOT:  out = ~v[0];       break;
+    case libflo::opcode::NEG:  out = -v[0];       break;
+    case libflo::opcode::MOV:  out = v[0];        break;
+    case libflo::opcode::EQ:   out = v[0] == v[1]; break;
+    case libflo::opcode::NEQ:  out = v[0] != v[1]; break;
+    case libflo::opcode::LT:   out = v[0] < v[1];  break;
+    case libflo::opcode::GTE:  out = v[0] >= v[1]; break;
+    case libflo::opcode::MUX:  out = (v[0] & 1) ? v[1] : v[2]; break;
+
+    case libflo::opcode::DIV:
+        if (v[1] == 0)
+            return false;
+        out = v[0] / v[1];
+        break;
+
+    case libflo::opcode::CAT:
+    case libflo::opcode::CATD:
+        out = (op->width() >= 64) ? v[1] : ((v[0] << op->width()) | v[1]);
+        break;
+
+    case libflo::opcode::LSH:
+        out = (v[1] >= 64) ? 0 : (v[0] << v[1]);
+        break;
+
+    case libflo::opcode::RSH:
+    case libflo::opcode::RSHD:
+        out = (v[1] >= 64) ? 0 : (v[0] >> v[1]);
+        break;
+
+    case libflo::opcode::ARSH:
+        sign = 0;
+        if (op->s()->width() <= 64)
+            sign = (v[0] >> (op->s()->width() - 1)) & 1;
+        if (sign == 1)
+            v[0] |= ~mask(op->s()->width());
+        if (v[1] >= 64)
+            out = (sign == 1) ? UINT64_MAX : 0;
+        else
+            out = (sign == 1) ? ~(~v[0] >> v[1]) : (v[0] >> v[1]);
+        break;
+
+    case libflo::opcode::LOG2:
+        out = (v[0] == 0) ? 0 : bit_length(v[0]) - 1;
+        break;
+
+    default:
+        return false;
+    }
+
+    out &= mask(d->width());
+    return true;
+}
+
+std::shared_ptr<node> identity(const std::shared_ptr<operation> op)
+{
+    auto d = op->d();
+    auto operands = op->operands();
+    if (operands.size() != 2)
+        return NULL;
+
+    auto s = operands[0];
+    auto t = operands[1];
+    uint64_t sv, tv;
+    bool sc = s->const_value(sv);
+    bool tc = t->const_value(tv);
+
+    switch (op->op()) {
+    case libflo::opcode::ADD:
+    case libflo::opcode::OR:
+    case libflo::opcode::XOR:
+        if (sc == true && sv == 0 && t->width() == d->width())
+            return t;
+        if (tc == true && tv == 0 && s->width() == d->width())
+            return s;
+        break;
+
+    case libflo::opcode::SUB:
+    case libflo::opcode::LSH:
+    case libflo::opcode::RSH:
+    case libflo::opcode::ARSH:
+        if (tc == true && tv == 0 && s->width() == d->width())
+            return s;
+        break;
+
+    case libflo::opcode::AND:
+    case libflo::opcode::MUL:
+        if ((sc == true && sv == 0) || (tc == true && tv == 0))
+            return make_constant(d->width(), 0);
+        break;
+
+    default:
+        break;
+    }
+
+    return NULL;
+}
+
+std::shared_ptr<operation> substitute(const std::shared_ptr<operation> op,
+                                      const subst_t& subst)
+{
+    bool changed = false;
+    auto operands = op->operands();
+    for (auto& n: operands) {
+        auto l = subst.find(n.get());
+        if (l == subst.end())
+            continue;
+
+        n = l->second;
+        changed = true;
+    }
+
+    if (changed == false)
+        return op;
+
+    return operation::make(op->d(), op->width(), op->op(), operands);
+}
+
+std::string cse_key(const std::shared_ptr<operation> op)
+{
+    std::vector<std::string> names;
+    for (const auto& n: op->operands()) {
+        if (n->is_const() == true)
+            names.push_back("#" + n->name() + "'" + std::to_string(n->width()));
+        else
+            names.push_back(n->name());
+    }
+
+    switch (op->op()) {
+    case libflo::opcode::ADD:
+    case libflo::opcode::AND:
+    case libflo::opcode::EQ:
+    case libflo::opcode::MUL:
+    case libflo::opcode::NEQ:
+    case libflo::opcode::OR:
+    case libflo::opcode::XOR:
+        std::sort(names.begin(), names.end());
+        break;
+
+    default:
+        break;
+    }
+
+    auto key = libflo::opcode_to_string(op->op())
+        + "'" + std::to_string(op->width())
+        + "'" + std::to_string(op->d()->width());
+    for (const auto& name: names)
+        key += " " + name;
+    return key;
+}
+
+uint64_t mask(size_t width)
+{
+    return (width >= 64) ? UINT64_MAX : ((1ULL << width) - 1);
+}
+
+size_t bit_length(uint64_t value)
+{
+    size_t out = 0;
+    while (value != 0) {
+        value >>= 1;
+        out++;
+    }
+    return out;
+}
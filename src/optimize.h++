@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of flo-llvm.
+ *
+ * flo-llvm is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * flo-llvm is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with flo-llvm.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OPTIMIZE_HXX
+#define OPTIMIZE_HXX
+
+#include "flo.h++"
+#include "node.h++"
+#include "operation.h++"
+#include <map>
+#include <memory>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+/* Runs a pipeline of passes over a Flo graph before any code is
+ * generated from it, producing a smaller graph that computes exactly
+ * the same value for every node that can be seen from outside of
+ * clock_lo.  Nodes that are exported into the header or the VCD file
+ * (along with memories) are never removed, so every pass only ever
+ * gets rid of Chisel's temporaries.
+ *
+ * Every pass is a single sweep over the operations in dataflow order,
+ * which is the order they're kept in.  Passes that remove a node
+ * replace every later use of it with an equivalent node, so the graph
+ * stays in dataflow order. */
+class optimizer {
+public:
+    /* The number of operations and nodes before and after a pass. */
+    class pass {
+    private:
+        std::string _name;
+        size_t _ops_before, _nodes_before;
+        size_t _ops_after, _nodes_after;
+
+    public:
+        pass(const std::string name,
+             size_t ops_before, size_t nodes_before,
+             size_t ops_after, size_t nodes_after);
+
+    public:
+        const std::string& name(void) const { return _name; }
+        size_t ops_before(void) const { return _ops_before; }
+        size_t nodes_before(void) const { return _nodes_before; }
+        size_t ops_after(void) const { return _ops_after; }
+        size_t nodes_after(void) const { return _nodes_after; }
+    };
+
+private:
+    std::map<std::string, std::shared_ptr<node>> _nodes;
+    std::vector<std::shared_ptr<operation>> _ops;
+    std::vector<pass> _passes;
+    size_t _narrowed;
+
+public:
+    /* Runs every pass over the given design.  The original list of
+     * operations isn't modified, but its nodes are shared with the
+     * result and so get the live widths found by narrow(). */
+    optimizer(const flo_ptr flo);
+
+public:
+    /* Returns the optimized design. */
+    flo_ptr result(void) const;
+
+    /* Writes out the operation and node counts around every pass. */
+    void report(FILE *f) const;
+
+private:
+    /* Folds operations whose operands are all constants, along with
+     * some identities (like adding zero) that just copy a node. */
+    void constprop(void);
+
+    /* Replaces operations that compute something that's already been
+     * computed by another operation with that operation's result. */
+    void cse(void);
+
+    /* Removes MOV operations between temporaries, and has operations
+     * that compute a temporary that's just copied into an exported
+     * node compute the exported node directly instead. */
+    void coalesce(void);
+
+    /* Finds how many low-order bits of every node can ever be set.
+     * Nodes that are always zero become constants, and the rest are
+     * recorded so wide arithmetic on small values can be emitted in
+     * a single word. */
+    void narrow(void);
+
+    /* Removes operations whose results are never used. */
+    void dce(void);
+
+    /* Runs a single pass, recording its counts. */
+    void run(const std::string name, void (optimizer::*f)(void));
+
+    /* Counts the nodes that are still used by the graph.  Passes
+     * other than DCE just stop using nodes without removing them. */
+    size_t live_nodes(void) const;
+};
+
+#endif
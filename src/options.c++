@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of flo-llvm.
+ *
+ * flo-llvm is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * flo-llvm is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with flo-llvm.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "options.h++"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+options::options(void)
+    : _native_state(false),
+      _cycles(0),
+      _lanes(1),
+      _threads(1),
+      _chunk(0),
+      _activity(false),
+      _binary_trace(false),
+      _optimize(false),
+      _pass_stats(false),
+      _profile(false)
+{
+}
+
+bool options::parse(const std::string arg)
+{
+    if (strcmp(arg.c_str(), "--native-state") == 0) {
+        _native_state = true;
+        return true;
+    }
+
+    if (strncmp(arg.c_str(), "--cycles=", strlen("--cycles=")) == 0) {
+        _cycles = atol(arg.c_str() + strlen("--cycles="));
+        return _cycles > 0;
+    }
+
+    if (strncmp(arg.c_str(), "--lanes=", strlen("--lanes=")) == 0) {
+        _lanes = atol(arg.c_str() + strlen("--lanes="));
+        return _lanes > 0;
+    }
+
+    if (strncmp(arg.c_str(), "--threads=", strlen("--threads=")) == 0) {
+        _threads = atol(arg.c_str() + strlen("--threads="));
+        return _threads > 0;
+    }
+
+    if (strncmp(arg.c_str(), "--chunk=", strlen("--chunk=")) == 0) {
+        _chunk = atol(arg.c_str() + strlen("--chunk="));
+        return _chunk > 0;
+    }
+
+    if (strcmp(arg.c_str(), "--activity") == 0) {
+        _activity = true;
+        return true;
+    }
+
+    if (strcmp(arg.c_str(), "--binary-trace") == 0) {
+        _binary_trace = true;
+        return true;
+    }
+
+    if (strcmp(arg.c_str(), "--optimize") == 0) {
+        _optimize = true;
+        return true;
+    }
+
+    if (strcmp(arg.c_str(), "--pass-stats") == 0) {
+        _pass_stats = true;
+        return true;
+    }
+
+    if (strcmp(arg.c_str(), "--profile") == 0) {
+        _profile = true;
+        return true;
+    }
+
+    return false;
+}
+
+void options::usage(FILE *f)
+{
+    fprintf(f, "  valid options are:\n");
+    fprintf(f, "    --native-state: Accesses a flat state struct directly\n");
+    fprintf(f, "    --cycles=N:     Runs N cycles in-process (with --jit)\n");
+    fprintf(f, "    --lanes=N:      Simulates N copies of the design at once\n");
+    fprintf(f, "    --threads=N:    Splits each cycle between N threads\n");
+    fprintf(f, "    --chunk=N:      Splits each cycle into functions of size N\n");
+    fprintf(f, "    --activity:     Skips logic whose inputs didn't change\n");
+    fprintf(f, "    --binary-trace: Dumps a binary trace instead of a VCD\n");
+    fprintf(f, "    --optimize:     Optimizes the Flo graph before codegen\n");
+    fprintf(f, "    --pass-stats:   Reports the graph's size around every pass\n");
+    fprintf(f, "    --profile:      Counts the time spent in each class of operation\n");
+}
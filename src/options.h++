@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of flo-llvm.
+ *
+ * flo-llvm is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * flo-llvm is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with flo-llvm.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OPTIONS_HXX
+#define OPTIONS_HXX
+
+#include <stdio.h>
+#include <string>
+
+/* Holds the code generation options that were passed on the command
+ * line.  Note that these change the interface between the generated
+ * header, compatibility layer and IR, so every one of those must be
+ * generated with exactly the same set of options. */
+class options {
+private:
+    bool _native_state;
+    size_t _cycles;
+    size_t _lanes;
+    size_t _threads;
+    size_t _chunk;
+    bool _activity;
+    bool _binary_trace;
+    bool _optimize;
+    bool _pass_stats;
+    bool _profile;
+
+public:
+    /* Creates the default set of options, which generates code that
+     * matches Chisel's C++ emulator as closely as possible. */
+    options(void);
+
+public:
+    /* Returns TRUE if flo-llvm should own a flat state structure
+     * that's accessed directly by the generated code, rather than
+     * going through the per-node accessor functions. */
+    bool native_state(void) const
+        { return _native_state || _lanes > 1 || _threads > 1 || _chunk > 0
+                 || _activity; }
+
+    /* Returns the number of cycles that an in-process build should
+     * run for, or 0 when it should write out object files instead. */
+    size_t cycles(void) const { return _cycles; }
+
+    /* Returns the number of independent copies of the design that
+     * are simulated at once, each in its own lane of every LLVM
+     * vector.  More than one lane implies a native state. */
+    size_t lanes(void) const { return _lanes; }
+
+    /* Returns the number of threads that clock_lo can be split
+     * between.  More than one thread implies a native state. */
+    size_t threads(void) const { return _threads; }
+
+    /* Returns the largest amount of work that a single function of
+     * clock_lo can contain, or 0 when it's not bounded.  Passing
+     * values between these functions goes through the state, so a
+     * bound implies a native state. */
+    size_t chunk(void) const { return _chunk; }
+
+    /* Returns TRUE if clock_lo should skip the parts of the design
+     * whose inputs haven't changed since the last cycle, which keeps
+     * their results in the state and so implies a native state. */
+    bool activity(void) const { return _activity; }
+
+    /* Returns TRUE if dump() should write the compact binary trace
+     * instead of a VCD file, which flo-llvm-trace2vcd converts back
+     * later. */
+    bool binary_trace(void) const { return _binary_trace; }
+
+    /* Returns TRUE if the Flo graph should be optimized before any
+     * code is generated from it. */
+    bool optimize(void) const { return _optimize || _pass_stats; }
+
+    /* Returns TRUE if the size of the graph around every optimization
+     * pass should be written to stderr. */
+    bool pass_stats(void) const { return _pass_stats; }
+
+    /* Returns TRUE if clock_lo should count the cycles it spends on
+     * each class of operation, including the accessor calls (or state
+     * accesses) that move values in and out of it.  The counters are
+     * written out by dump_profile(). */
+    bool profile(void) const { return _profile; }
+
+public:
+    /* Parses a single command-line option, returning FALSE if it
+     * isn't a valid option. */
+    bool parse(const std::string arg);
+
+    /* Prints the list of valid options. */
+    static void usage(FILE *f);
+};
+
+#endif
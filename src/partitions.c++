@@ -0,0 +1,306 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of flo-llvm.
+ *
+ * flo-llvm is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * flo-llvm is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with flo-llvm.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "partitions.h++"
+#include <libflo/sizet_printf.h++>
+#include <algorithm>
+#include <functional>
+#include <set>
+
+#ifndef BUFFER_SIZE
+#define BUFFER_SIZE 1024
+#endif
+
+/* Returns TRUE if the operation only loads its node from the state,
+ * which means it's cheaper to load it again than to share it. */
+static bool is_state_load(const std::shared_ptr<operation> op);
+
+/* Returns TRUE if a bounded serial partition ends right after the
+ * given operation, which happens on average every "chunk / 2" work.
+ * This only depends on the operation itself, so partitions line back
+ * up right after an edit rather than every one after it moving. */
+static bool is_chunk_boundary(const std::shared_ptr<operation> op,
+                              size_t chunk);
+
+partitions::partition::partition(void)
+    : _ops(),
+      _imports(),
+      _nexts(),
+      _cost(0)
+{
+}
+
+partitions::partitions(const flo_ptr flo, size_t threads, size_t chunk)
+    : _threads(threads),
+      _stages(),
+      _shared(),
+      _is_shared()
+{
+    size_t total = 0;
+    for (const auto& op: flo->operations())
+        total += cost(op);
+
+    /* Small designs don't have enough work to keep every thread
+     * busy, so they use fewer threads (or just run serially). */
+    if (_threads > total / min_thread_cost)
+        _threads = total / min_thread_cost;
+    if (_threads < 1)
+        _threads = 1;
+
+    if (_threads == 1 && chunk == 0) {
+        _stages.push_back(std::vector<partition>(1));
+        auto& part = _stages[0][0];
+
+        for (const auto& op: flo->operations()) {
+            part._ops.push_back(op);
+            part._cost += cost(op);
+            if (op->op() == libflo::opcode::REG)
+                part._nexts.push_back(op);
+        }
+
+        return;
+    }
+
+    typedef std::pair<size_t, size_t> location;
+    auto stage = [&](size_t s) -> std::vector<partition>& {
+        while (_stages.size() <= s)
+            _stages.push_back(std::vector<partition>(_threads));
+        return _stages[s];
+    };
+    auto least_loaded = [&](size_t s) -> size_t {
+        auto& parts = stage(s);
+        size_t t = 0;
+        for (size_t i = 1; i < parts.size(); ++i)
+            if (parts[i]._cost < parts[t]._cost)
+                t = i;
+        return t;
+    };
+
+    /* Memories are read and written in place, so accesses to the
+     * same memory must stay in the order they were in originally. */
+    std::map<std::string, location> placed;
+    std::map<std::string, std::vector<location>> mem_reads;
+    std::map<std::string, location> mem_write;
+
+    for (const auto& op: flo->operations()) {
+        if (is_state_load(op) == true)
+            continue;
+
+        /* A single thread just fills up each partition in order,
+         * which trivially keeps everything in dataflow order. */
+        if (_threads == 1) {
+            size_t s = _stages.size() == 0 ? 0 : _stages.size() - 1;
+            if (stage(s)[0]._cost > 0
+                && stage(s)[0]._cost + cost(op) > chunk)
+                s++;
+
+            auto& part = stage(s)[0];
+            part._ops.push_back(op);
+            part._cost += cost(op);
+            placed[op->d()->name()] = location(s, 0);
+
+            if (is_chunk_boundary(op, chunk))
+                stage(s + 1);
+
+            continue;
+        }
+
+        std::vector<location> deps;
+        for (const auto& n: op->sources()) {
+            auto l = placed.find(n->name());
+            if (l != placed.end())
+                deps.push_back(l->second);
+        }
+
+        bool is_rd = (op->op() == libflo::opcode::RD);
+        bool is_wr = (op->op() == libflo::opcode::WR);
+        if (is_rd || is_wr) {
+            auto mem = op->t()->name();
+
+            auto l = mem_write.find(mem);
+            if (l != mem_write.end())
+                deps.push_back(l->second);
+
+            if (is_wr)
+                for (const auto& r: mem_reads[mem])
+                    deps.push_back(r);
+        }
+
+        /* Operations go in the earliest stage that's allowed, which
+         * is the same stage as their producers if those are all in
+         * the same partition. */
+        size_t s = 0;
+        for (const auto& d: deps)
+            s = std::max(s, d.first);
+
+        std::set<size_t> threads_in_stage;
+        for (const auto& d: deps)
+            if (d.first == s)
+                threads_in_stage.insert(d.second);
+
+        size_t t;
+        if (threads_in_stage.size() == 0) {
+            t = least_loaded(s);
+        } else if (threads_in_stage.size() == 1) {
+            t = *threads_in_stage.begin();
+        } else {
+            s++;
+            t = least_loaded(s);
+        }
+
+        /* Full partitions can't take any more work, but it's always
+         * safe to move an operation later. */
+        while (chunk > 0
+               && stage(s)[t]._cost > 0
+               && stage(s)[t]._cost + cost(op) > chunk) {
+            s++;
+            t = least_loaded(s);
+        }
+
+        auto& part = stage(s)[t];
+        part._ops.push_back(op);
+        part._cost += cost(op);
+        placed[op->d()->name()] = location(s, t);
+
+        if (is_wr) {
+            mem_write[op->t()->name()] = location(s, t);
+            mem_reads[op->t()->name()].clear();
+        }
+        if (is_rd)
+            mem_reads[op->t()->name()].push_back(location(s, t));
+    }
+
+    /* The next value of a register is stored by whichever partition
+     * computes it. */
+    for (const auto& op: flo->operations()) {
+        if (op->op() != libflo::opcode::REG)
+            continue;
+
+        auto l = placed.find(op->t()->name());
+        if (l == placed.end())
+            stage(0)[0]._nexts.push_back(op);
+        else
+            stage(l->second.first)[l->second.second]._nexts.push_back(op);
+    }
+
+    /* Now that everything has been placed it's possible to figure out
+     * which nodes need to be passed between partitions. */
+    for (size_t s = 0; s < _stages.size(); ++s) {
+        for (size_t t = 0; t < _threads; ++t) {
+            auto& part = _stages[s][t];
+
+            std::vector<std::shared_ptr<node>> used;
+            for (const auto& op: part._ops)
+                for (const auto& n: op->sources())
+                    used.push_back(n);
+            for (const auto& op: part._nexts)
+                used.push_back(op->t());
+
+            std::set<std::string> imported;
+            for (const auto& n: used) {
+                if (n->is_const() == true)
+                    continue;
+
+                auto l = placed.find(n->name());
+                if (l != placed.end() && l->second == location(s, t))
+                    continue;
+
+                if (imported.find(n->name()) != imported.end())
+                    continue;
+                imported.insert(n->name());
+                part._imports.push_back(n);
+
+                if (l == placed.end() || n->exported() == true)
+                    continue;
+
+                if (_is_shared.find(n->name()) == _is_shared.end()) {
+                    _is_shared[n->name()] = true;
+                    _shared.push_back(n);
+                }
+            }
+        }
+    }
+}
+
+bool partitions::is_shared(const std::shared_ptr<node> n) const
+{
+    return _is_shared.find(n->name()) != _is_shared.end();
+}
+
+const std::string partitions::function_name(const flo_ptr flo,
+                                            size_t stage,
+                                            size_t thread) const
+{
+    /* Partitions are named after what they compute rather than where
+     * they are, so that an edit to one part of a design doesn't rename
+     * every partition after it.  No two partitions share an operation,
+     * so the names are unique. */
+    const auto& part = at(stage, thread);
+    std::string contents;
+    for (const auto& op: part.ops())
+        contents += op->to_string() + "\n";
+    for (const auto& op: part.nexts())
+        contents += "next " + op->d()->name() + "\n";
+
+    char buffer[BUFFER_SIZE];
+    snprintf(buffer, BUFFER_SIZE,
+             "_llvmflo_%s_clock_lo_%016llx",
+             flo->class_name().c_str(),
+             (unsigned long long)std::hash<std::string>()(contents));
+    return buffer;
+}
+
+size_t partitions::cost(const std::shared_ptr<operation> op)
+{
+    size_t words = (op->d()->width() + 63) / 64;
+
+    switch (op->op()) {
+    case libflo::opcode::INIT:
+        return 0;
+
+    case libflo::opcode::DIV:
+    case libflo::opcode::MUL:
+    case libflo::opcode::RD:
+    case libflo::opcode::WR:
+        return 4 * words;
+
+    default:
+        return words;
+    }
+}
+
+bool is_state_load(const std::shared_ptr<operation> op)
+{
+    switch (op->op()) {
+    case libflo::opcode::IN:
+    case libflo::opcode::REG:
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+bool is_chunk_boundary(const std::shared_ptr<operation> op, size_t chunk)
+{
+    return std::hash<std::string>()(op->d()->name()) % chunk
+        < 2 * partitions::cost(op);
+}
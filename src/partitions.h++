@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of flo-llvm.
+ *
+ * flo-llvm is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * flo-llvm is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with flo-llvm.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PARTITIONS_HXX
+#define PARTITIONS_HXX
+
+#include "flo.h++"
+#include "node.h++"
+#include "operation.h++"
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+/* Splits the operations that make up clock_lo into partitions that
+ * can be run in parallel.  The partitions are arranged into a number
+ * of stages, each of which has one partition per thread: partitions
+ * in the same stage never depend on each other, so the only
+ * synchronization that's necessary is a barrier between stages.
+ *
+ * Operations are placed greedily in dataflow order: each one goes
+ * into the first stage after everything it depends on, joining the
+ * partition of its producer when that's possible and otherwise going
+ * to the least loaded thread.  IN and REG operations only load from
+ * the state, so they're never placed; every partition that needs one
+ * of those nodes just loads it itself.
+ *
+ * The amount of work in a single partition can also be bounded, which
+ * keeps LLVM's optimizer from having to deal with enormous functions.
+ * Partitions that are full push operations into a later stage. */
+class partitions {
+public:
+    /* Designs with less work than this per thread run serially, as
+     * there's no way synchronizing the threads will pay off. */
+    static const size_t min_thread_cost = 2048;
+
+    /* A single partition of clock_lo. */
+    class partition {
+    private:
+        std::vector<std::shared_ptr<operation>> _ops;
+        std::vector<std::shared_ptr<node>> _imports;
+        std::vector<std::shared_ptr<operation>> _nexts;
+        size_t _cost;
+
+    public:
+        partition(void);
+
+    public:
+        /* The operations in this partition, in dataflow order. */
+        const std::vector<std::shared_ptr<operation>>& ops(void) const
+            { return _ops; }
+
+        /* The nodes that this partition uses but doesn't compute, so
+         * they must be loaded from the state first. */
+        const std::vector<std::shared_ptr<node>>& imports(void) const
+            { return _imports; }
+
+        /* The registers whose next value is stored by this
+         * partition. */
+        const std::vector<std::shared_ptr<operation>>& nexts(void) const
+            { return _nexts; }
+
+        /* An estimate of how long this partition takes to run. */
+        size_t cost(void) const { return _cost; }
+
+        bool empty(void) const { return _ops.size() == 0 && _nexts.size() == 0; }
+
+        friend class partitions;
+    };
+
+private:
+    size_t _threads;
+    std::vector<std::vector<partition>> _stages;
+    std::vector<std::shared_ptr<node>> _shared;
+    std::map<std::string, bool> _is_shared;
+
+public:
+    /* Partitions the given design for (at most) the given number of
+     * threads, with (when it's not 0) at most "chunk" work in each
+     * partition. */
+    partitions(const flo_ptr flo, size_t threads, size_t chunk = 0);
+
+public:
+    /* The number of threads the design is split between, which is 1
+     * when it's run serially.  This only depends on the design, the
+     * pools that run it use fewer threads on machines that have fewer
+     * cores. */
+    size_t threads(void) const { return _threads; }
+
+    /* The number of stages, each of which is followed by a barrier. */
+    size_t stages(void) const { return _stages.size(); }
+
+    const partition& at(size_t stage, size_t thread) const
+        { return _stages[stage][thread]; }
+
+    /* The nodes that are computed by one partition and used by
+     * another, but wouldn't otherwise be stored in the state. */
+    const std::vector<std::shared_ptr<node>>& shared(void) const
+        { return _shared; }
+    bool is_shared(const std::shared_ptr<node> n) const;
+
+    /* Returns the name of the LLVM function for a partition, which
+     * only depends on the operations in it. */
+    const std::string function_name(const flo_ptr flo,
+                                    size_t stage,
+                                    size_t thread) const;
+
+    /* Returns an estimate of how long an operation takes to run. */
+    static size_t cost(const std::shared_ptr<operation> op);
+};
+
+#endif
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of flo-llvm.
+ *
+ * flo-llvm is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * flo-llvm is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with flo-llvm.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "pool.h++"
+
+/* Returns the number of threads that run the given number of
+ * partitions on this machine. */
+static size_t pool_threads(size_t partitions);
+
+pool::pool(const std::vector<std::vector<func_t>>& stages, size_t partitions)
+    : _stages(stages),
+      _partitions(partitions),
+      _threads(pool_threads(partitions)),
+      _workers(),
+      _arrived(0),
+      _phase(0),
+      _sleeping(0),
+      _lock(),
+      _wake(),
+      _stop(false),
+      _state(NULL),
+      _reset(false)
+{
+    /* The calling thread is thread 0, so it doesn't need a worker. */
+    for (size_t t = 1; t < _threads; ++t)
+        _workers.push_back(std::thread(&pool::work, this, t));
+}
+
+pool::~pool(void)
+{
+    _stop.store(true, std::memory_order_relaxed);
+    barrier();
+
+    for (auto& worker: _workers)
+        worker.join();
+}
+
+void pool::clock_lo(uint64_t *state, bool reset)
+{
+    _state = state;
+    _reset = reset;
+    barrier();
+    run(0);
+}
+
+void pool::barrier(void)
+{
+    auto phase = _phase.load(std::memory_order_acquire);
+
+    if (_arrived.fetch_add(1, std::memory_order_acq_rel) + 1 == _threads) {
+        _arrived.store(0, std::memory_order_relaxed);
+
+        /* Both of these are sequentially consistent so a thread can't
+         * both miss the new phase and not be counted as sleeping. */
+        _phase.store(phase + 1);
+        if (_sleeping.load() > 0) {
+            std::lock_guard<std::mutex> lock(_lock);
+            _wake.notify_all();
+        }
+        return;
+    }
+
+    for (size_t spins = 0; spins < POOL_SPINS; ++spins)
+        if (_phase.load(std::memory_order_acquire) != phase)
+            return;
+
+    std::unique_lock<std::mutex> lock(_lock);
+    _sleeping.fetch_add(1);
+    while (_phase.load() == phase)
+        _wake.wait(lock);
+    _sleeping.fetch_sub(1);
+}
+
+void pool::run(size_t thread)
+{
+    for (const auto& stage: _stages) {
+        for (size_t p = thread; p < _partitions; p += _threads)
+            if (stage[p] != NULL)
+                stage[p](_state, _reset);
+        barrier();
+    }
+}
+
+void pool::work(size_t thread)
+{
+    while (true) {
+        barrier();
+        if (_stop.load(std::memory_order_relaxed) == true)
+            return;
+        run(thread);
+    }
+}
+
+size_t pool_threads(size_t partitions)
+{
+    size_t cores = std::thread::hardware_concurrency();
+    if (cores > 0 && partitions > cores)
+        return cores;
+    return partitions;
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of flo-llvm.
+ *
+ * flo-llvm is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * flo-llvm is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with flo-llvm.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef POOL_HXX
+#define POOL_HXX
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+/* The number of times a thread checks the barrier before it gives up
+ * and sleeps until the others get there.  Waking a thread costs a few
+ * microseconds, so this is about how long it's worth spinning for.
+ * The pools that are generated into headers use this too. */
+#ifndef POOL_SPINS
+#define POOL_SPINS 16384
+#endif
+
+/* A persistent set of threads that runs the partitions of clock_lo,
+ * as produced by the partitions class.  Every thread runs its
+ * partition of a stage and then waits at a barrier for the others, so
+ * there's no synchronization at all within a stage.  The threads
+ * stick around between cycles because starting them once per cycle
+ * would cost far more than the cycle itself.  They spin at the barrier
+ * for a while, but then go to sleep so a pool that isn't being clocked
+ * doesn't keep its cores busy.
+ *
+ * There's never more threads than there are cores to run them, as
+ * they'd just spin waiting for each other: on smaller machines each
+ * thread runs more than one of a stage's partitions. */
+class pool {
+public:
+    typedef void (*func_t)(uint64_t *state, bool reset);
+
+private:
+    /* Indexed first by stage and then by partition, NULL entries are
+     * partitions with nothing to do. */
+    const std::vector<std::vector<func_t>> _stages;
+    const size_t _partitions;
+    const size_t _threads;
+    std::vector<std::thread> _workers;
+
+    /* This is a sense-reversing barrier: the last thread to arrive
+     * resets the count and bumps the phase, which every other thread
+     * is waiting to see change.  Threads that have waited too long
+     * sleep on "_wake", and are counted in "_sleeping" so the last
+     * thread only needs to take the lock when someone is asleep. */
+    std::atomic<size_t> _arrived;
+    std::atomic<size_t> _phase;
+    std::atomic<size_t> _sleeping;
+    std::mutex _lock;
+    std::condition_variable _wake;
+    std::atomic<bool> _stop;
+
+    /* The arguments to the current cycle, which are published to the
+     * workers by the barrier that starts it. */
+    uint64_t *_state;
+    bool _reset;
+
+public:
+    /* Runs stages that have the given number of partitions each. */
+    pool(const std::vector<std::vector<func_t>>& stages, size_t partitions);
+    ~pool(void);
+
+public:
+    /* Runs every partition of clock_lo once, returning after they've
+     * all finished. */
+    void clock_lo(uint64_t *state, bool reset);
+
+private:
+    void barrier(void);
+    void run(size_t thread);
+    void work(size_t thread);
+};
+
+#endif
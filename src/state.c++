@@ -0,0 +1,235 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of flo-llvm.
+ *
+ * flo-llvm is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * flo-llvm is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with flo-llvm.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "state.h++"
+#include <libflo/sizet_printf.h++>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+
+state_layout::field::field(const std::shared_ptr<node> n, bool next,
+                           size_t offset, size_t words)
+    : _n(n),
+      _next(next),
+      _last(false),
+      _name(""),
+      _offset(offset),
+      _words(words)
+{
+}
+
+state_layout::field::field(const std::shared_ptr<node> n, bool next,
+                           bool last, size_t offset, size_t words)
+    : _n(n),
+      _next(next),
+      _last(last),
+      _name(""),
+      _offset(offset),
+      _words(words)
+{
+}
+
+state_layout::field::field(const std::string name,
+                           size_t offset, size_t words)
+    : _n(NULL),
+      _next(false),
+      _last(false),
+      _name(name),
+      _offset(offset),
+      _words(words)
+{
+}
+
+const std::string state_layout::field::name(void) const
+{
+    if (_n != NULL)
+        return _n->mangled_name() + (_next ? "__next" : "") + (_last ? "__last" : "");
+
+    if (_name.size() > 0)
+        return _name;
+
+    return "__pad" + std::to_string(_offset);
+}
+
+state_layout::state_layout(const flo_ptr flo, size_t lanes,
+                           const std::vector<std::shared_ptr<node>>& extra,
+                           const std::vector<std::shared_ptr<node>>& lasts,
+                           const std::vector<std::pair<std::string, size_t>>& raws)
+    : _lanes(lanes),
+      _fields(),
+      _offsets(),
+      _next_offsets(),
+      _last_offsets(),
+      _raw_offsets(),
+      _regs_words(0),
+      _nexts_offset(0),
+      _words(0)
+{
+    std::vector<std::shared_ptr<node>> regs;
+    for (const auto& op: flo->operations())
+        if (op->op() == libflo::opcode::REG)
+            regs.push_back(op->d());
+
+    /* Pads the state out to the next cache line. */
+    auto pad = [&](void) {
+        if (_words % line_words == 0)
+            return;
+
+        auto w = line_words - (_words % line_words);
+        _fields.push_back(field(NULL, false, _words, w));
+        _words += w;
+    };
+
+    for (const auto& reg: regs) {
+        _offsets[reg->name()] = _words;
+        _fields.push_back(field(reg, false, _words, node_words(reg)));
+        _words += node_words(reg);
+    }
+    _regs_words = _words;
+    pad();
+
+    _nexts_offset = _words;
+    for (const auto& reg: regs) {
+        _next_offsets[reg->name()] = _words;
+        _fields.push_back(field(reg, true, _words, node_words(reg)));
+        _words += node_words(reg);
+    }
+    pad();
+
+    for (const auto& node: flo->nodes()) {
+        if (node->exported() == false)
+            continue;
+
+        if (_offsets.find(node->name()) != _offsets.end())
+            continue;
+
+        _offsets[node->name()] = _words;
+        _fields.push_back(field(node, false, _words, node_words(node)));
+        _words += node_words(node);
+    }
+
+    for (const auto& node: extra) {
+        if (_offsets.find(node->name()) != _offsets.end())
+            continue;
+
+        _offsets[node->name()] = _words;
+        _fields.push_back(field(node, false, _words, node_words(node)));
+        _words += node_words(node);
+    }
+
+    for (const auto& node: lasts) {
+        if (_last_offsets.find(node->name()) != _last_offsets.end())
+            continue;
+
+        _last_offsets[node->name()] = _words;
+        _fields.push_back(field(node, false, true, _words, node_words(node)));
+        _words += node_words(node);
+    }
+
+    for (const auto& raw: raws) {
+        _raw_offsets[raw.first] = _words;
+        _fields.push_back(field(raw.first, _words, raw.second));
+        _words += raw.second;
+    }
+    pad();
+}
+
+size_t state_layout::node_words(const std::shared_ptr<node> n) const
+{
+    /* mem_t is itself polymorphic, so it has a header before its
+     * array of dat_t. */
+    if (n->is_mem())
+        return header_words() + stride(n) * n->depth();
+
+    return stride(n);
+}
+
+size_t state_layout::stride(const std::shared_ptr<node> n) const
+{
+    return header_words() + (n->width() + 63) / 64 * _lanes;
+}
+
+bool state_layout::has_slot(const std::shared_ptr<node> n) const
+{
+    return _offsets.find(n->name()) != _offsets.end();
+}
+
+size_t state_layout::offset(const std::shared_ptr<node> n) const
+{
+    auto l = _offsets.find(n->name());
+    if (l == _offsets.end()) {
+        fprintf(stderr, "Node '%s' has no state\n", n->name().c_str());
+        abort();
+    }
+
+    if (n->is_mem())
+        return l->second + header_words() + header_words();
+
+    return l->second + header_words();
+}
+
+size_t state_layout::next_offset(const std::shared_ptr<node> n) const
+{
+    auto l = _next_offsets.find(n->name());
+    if (l == _next_offsets.end()) {
+        fprintf(stderr, "Node '%s' isn't a register\n", n->name().c_str());
+        abort();
+    }
+
+    return l->second + header_words();
+}
+
+size_t state_layout::last_offset(const std::shared_ptr<node> n) const
+{
+    auto l = _last_offsets.find(n->name());
+    if (l == _last_offsets.end()) {
+        fprintf(stderr, "Node '%s' has no last value\n", n->name().c_str());
+        abort();
+    }
+
+    return l->second + header_words();
+}
+
+size_t state_layout::raw_offset(const std::string name) const
+{
+    auto l = _raw_offsets.find(name);
+    if (l == _raw_offsets.end()) {
+        fprintf(stderr, "State has no field '%s'\n", name.c_str());
+        abort();
+    }
+
+    return l->second;
+}
+
+const state_layout::field& state_layout::field_at(size_t offset) const
+{
+    /* Fields are stored in order, so this is the last one that
+     * starts at or before the offset. */
+    auto l = std::upper_bound(_fields.begin(), _fields.end(), offset,
+                              [](size_t o, const field& f)
+                              { return o < f.offset(); });
+    if (l == _fields.begin() || offset >= _words) {
+        fprintf(stderr, "Word " SIZET_FORMAT " isn't in the state\n", offset);
+        abort();
+    }
+
+    return *(l - 1);
+}
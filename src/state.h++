@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of flo-llvm.
+ *
+ * flo-llvm is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * flo-llvm is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with flo-llvm.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STATE_HXX
+#define STATE_HXX
+
+#include "flo.h++"
+#include "node.h++"
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+/* The words that make up a design's persistent state, laid out flat
+ * so the generated code can access every field with a single offset
+ * from the start of the state structure rather than calling back into
+ * C++.  Registers are placed first, followed by a shadow copy of each
+ * register's next value, so clock_hi can be performed as a single
+ * bulk copy.
+ *
+ * Every field is really a Chisel dat_t or mem_t, which means the
+ * Chisel API continues to work directly on top of this state.  Those
+ * classes are polymorphic, so each one starts with a single header
+ * word (the vtable pointer) before the actual data.
+ *
+ * When simulating more than one lane at a time the state is instead
+ * made up of raw words, stored lane-major: every word of a value is
+ * followed by that same word for every other lane, which lets the
+ * generated code load a word for all lanes as a single vector. */
+class state_layout {
+public:
+    /* The number of 64-bit words that make up a single cache line,
+     * which is the alignment used for the register blocks. */
+    static const size_t line_words = 8;
+
+    /* A single field of the state structure.  Fields that don't have
+     * a node are just raw words, which are padding unless they've
+     * been given a name. */
+    class field {
+    private:
+        std::shared_ptr<node> _n;
+        bool _next;
+        bool _last;
+        std::string _name;
+        size_t _offset;
+        size_t _words;
+
+    public:
+        field(const std::shared_ptr<node> n, bool next,
+              size_t offset, size_t words);
+        field(const std::shared_ptr<node> n, bool next, bool last,
+              size_t offset, size_t words);
+        field(const std::string name, size_t offset, size_t words);
+
+    public:
+        /* The node stored in this field, or NULL for raw words. */
+        const std::shared_ptr<node> n(void) const { return _n; }
+
+        /* TRUE when this field holds a register's next value. */
+        bool next(void) const { return _next; }
+
+        /* TRUE when this field holds a node's value from the end of
+         * the previous cycle. */
+        bool last(void) const { return _last; }
+
+        /* The name of the C++ member that holds this field. */
+        const std::string name(void) const;
+
+        /* TRUE when this field is only there for alignment. */
+        bool padding(void) const { return _n == NULL && _name.size() == 0; }
+
+        /* The location of this field, in words. */
+        size_t offset(void) const { return _offset; }
+        size_t words(void) const { return _words; }
+    };
+
+private:
+    size_t _lanes;
+    std::vector<field> _fields;
+    std::map<std::string, size_t> _offsets;
+    std::map<std::string, size_t> _next_offsets;
+    std::map<std::string, size_t> _last_offsets;
+    std::map<std::string, size_t> _raw_offsets;
+    size_t _regs_words;
+    size_t _nexts_offset;
+    size_t _words;
+
+public:
+    /* Lays out the state for every exported node in the given
+     * design, with every value replicated for the given number of
+     * lanes.  Any extra nodes are given space at the end of the
+     * state, which is used to pass values between threads or to keep
+     * them between cycles.  The last nodes get a second field that
+     * holds their value from the previous cycle, and each raw field
+     * is an array of the given number of words. */
+    state_layout(const flo_ptr flo, size_t lanes = 1,
+                 const std::vector<std::shared_ptr<node>>& extra = {},
+                 const std::vector<std::shared_ptr<node>>& lasts = {},
+                 const std::vector<std::pair<std::string, size_t>>& raws = {});
+
+public:
+    /* The number of independent copies of the design in the state. */
+    size_t lanes(void) const { return _lanes; }
+
+    /* The number of words at the start of every field that aren't
+     * part of its value, which is only the dat_t header. */
+    size_t header_words(void) const { return _lanes > 1 ? 0 : 1; }
+
+    /* Returns the number of 64-bit words needed to hold a node, which
+     * is the whole memory for memory nodes. */
+    size_t node_words(const std::shared_ptr<node> n) const;
+
+    /* Returns the number of words between two consecutive elements
+     * of a memory, or the size of a single dat_t for other nodes. */
+    size_t stride(const std::shared_ptr<node> n) const;
+
+    /* Returns every field in the state, in the order they're stored
+     * (including any padding). */
+    const std::vector<field>& fields(void) const { return _fields; }
+
+    /* Returns TRUE if the given node has a field in the state. */
+    bool has_slot(const std::shared_ptr<node> n) const;
+
+    /* Returns the word offset of the data in the given node's field,
+     * and of the data in the field that holds a register's next value.
+     * For memories this is the data of the first element. */
+    size_t offset(const std::shared_ptr<node> n) const;
+    size_t next_offset(const std::shared_ptr<node> n) const;
+    size_t last_offset(const std::shared_ptr<node> n) const;
+
+    /* Returns the word offset of a raw field. */
+    size_t raw_offset(const std::string name) const;
+
+    /* Returns the field that the word at the given offset is part
+     * of. */
+    const field& field_at(size_t offset) const;
+
+    /* The block of registers always starts at word 0, the block of
+     * next values is exactly as long and starts at a cache line. */
+    size_t regs_words(void) const { return _regs_words; }
+    size_t nexts_offset(void) const { return _nexts_offset; }
+
+    /* The total size of the state, in words. */
+    size_t words(void) const { return _words; }
+};
+
+#endif
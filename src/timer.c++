@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of flo-llvm.
+ *
+ * flo-llvm is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * flo-llvm is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with flo-llvm.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "timer.h++"
+#include <libflo/sizet_printf.h++>
+#include <sys/resource.h>
+#include <sys/time.h>
+
+timer::timer(void)
+    : _phases(),
+      _last(now())
+{
+}
+
+void timer::phase(const std::string name)
+{
+    double n = now();
+    _phases.push_back(std::make_pair(name, n - _last));
+    _last = n;
+}
+
+double timer::last(void) const
+{
+    if (_phases.size() == 0)
+        return 0;
+
+    return _phases[_phases.size() - 1].second;
+}
+
+void timer::report(FILE *f) const
+{
+    double total = 0;
+    for (const auto& phase: _phases) {
+        fprintf(f, "flo-llvm: %-12s %10.3f s\n",
+                phase.first.c_str(),
+                phase.second);
+        total += phase.second;
+    }
+
+    fprintf(f, "flo-llvm: %-12s %10.3f s\n", "total", total);
+    fprintf(f, "flo-llvm: %-12s " SIZET_FORMAT " KiB\n", "peak RSS", peak_rss());
+}
+
+double timer::now(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+size_t timer::peak_rss(void)
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+
+    /* Linux reports this in KiB already. */
+    return usage.ru_maxrss;
+}
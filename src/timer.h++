@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of flo-llvm.
+ *
+ * flo-llvm is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * flo-llvm is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with flo-llvm.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TIMER_HXX
+#define TIMER_HXX
+
+#include <stdio.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+/* Splits the run of flo-llvm into a sequence of named phases and
+ * keeps track of how long each of them took. */
+class timer {
+private:
+    std::vector<std::pair<std::string, double>> _phases;
+    double _last;
+
+public:
+    /* Starts the first phase right now. */
+    timer(void);
+
+public:
+    /* Ends the current phase, attributing all the time since the
+     * previous phase ended to it. */
+    void phase(const std::string name);
+
+    /* Returns the number of seconds the last phase took. */
+    double last(void) const;
+
+    /* Writes out how long every phase took, along with the peak
+     * memory usage of this process. */
+    void report(FILE *f) const;
+
+public:
+    /* Returns the current wall-clock time, in seconds. */
+    static double now(void);
+
+    /* Returns the peak resident set size of this process, in KiB. */
+    static size_t peak_rss(void);
+};
+
+#endif
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of flo-llvm.
+ *
+ * flo-llvm is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * flo-llvm is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with flo-llvm.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "trace.h++"
+
+void trace_put_varint(std::string& out, uint64_t value)
+{
+    while (value >= 0x80) {
+        out.push_back((char)((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+
+    out.push_back((char)value);
+}
+
+void trace_put_string(std::string& out, const std::string str)
+{
+    trace_put_varint(out, str.size());
+    out += str;
+}
+
+bool trace_get_varint(FILE *f, uint64_t& value)
+{
+    value = 0;
+    for (size_t shift = 0; shift < 64; shift += 7) {
+        int c = getc(f);
+        if (c == EOF)
+            return false;
+
+        value |= (uint64_t)(c & 0x7f) << shift;
+        if ((c & 0x80) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+bool trace_get_string(FILE *f, std::string& str)
+{
+    uint64_t size;
+    if (trace_get_varint(f, size) == false)
+        return false;
+
+    str.resize(size);
+    if (size > 0 && fread(&str[0], 1, size, f) != size)
+        return false;
+
+    return true;
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of flo-llvm.
+ *
+ * flo-llvm is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * flo-llvm is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with flo-llvm.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRACE_HXX
+#define TRACE_HXX
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+
+/* The binary trace is an alternative to VCD that's much cheaper to
+ * write out every cycle.  It's a stream of records, each of which
+ * starts with one of these tags:
+ *
+ *  'H': The magic string, the format version, the text of the VCD
+ *       header and then the width and VCD name of every signal.
+ *       This is written once, before the first cycle.
+ *
+ *  'K': A keyframe, which contains the value of every signal.
+ *
+ *  'C': A cycle, which contains only the signals that changed.
+ *
+ * Every number is an unsigned LEB128 varint.  Cycle records consist
+ * of the cycle number followed by a list of signals, each of which is
+ * encoded as the distance from the signal after the previous one
+ * (plus one, so zero can end the list) and then every word of the
+ * signal XORed with its value on the previous cycle.  Keyframes are
+ * encoded the same way but against zero, so a reader can start from
+ * any of them. */
+#define TRACE_MAGIC "flotrace"
+#define TRACE_VERSION 1
+#define TRACE_HEADER 'H'
+#define TRACE_KEYFRAME 'K'
+#define TRACE_CYCLE 'C'
+
+/* One in this many records is written as a keyframe. */
+#define TRACE_KEYFRAME_INTERVAL 1024
+
+/* Appends a varint to a string. */
+void trace_put_varint(std::string& out, uint64_t value);
+
+/* Appends a length-prefixed string to a string. */
+void trace_put_string(std::string& out, const std::string str);
+
+/* Reads a varint from a file, returning FALSE at the end of the
+ * file. */
+bool trace_get_varint(FILE *f, uint64_t& value);
+
+/* Reads a length-prefixed string from a file, returning FALSE at the
+ * end of the file. */
+bool trace_get_string(FILE *f, std::string& str);
+
+#endif
@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2014 Palmer Dabbelt
+ *   <palmer.dabbelt@eecs.berkeley.edu>
+ *
+ * This file is part of flo-llvm.
+ *
+ * flo-llvm is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * flo-llvm is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with flo-llvm.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "trace.h++"
+#include "version.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+/* Reads a single binary trace record into the current value of every
+ * signal, writing out those that changed in VCD format.  Returns
+ * FALSE if the trace ended in the middle of the record. */
+static bool convert_record(FILE *in, FILE *out, bool keyframe,
+                           const std::vector<size_t>& widths,
+                           const std::vector<std::string>& names,
+                           std::vector<std::vector<uint64_t>>& values,
+                           std::vector<std::vector<uint64_t>>& printed);
+
+int main(int argc, const char **argv)
+{
+    /* Prints the version if it was asked for. */
+    if (argc == 2 && strcmp(argv[1], "--version") == 0) {
+        fprintf(stderr, "%s\n", PCONFIGURE_VERSION);
+        exit(0);
+    }
+
+    if (argc < 2 || argc > 3 || strcmp(argv[1], "--help") == 0) {
+        fprintf(stderr, "%s: <trace> [vcd]\n", argv[0]);
+        fprintf(stderr, "  Converts a trace written by a design built with\n");
+        fprintf(stderr, "  --binary-trace to a VCD file\n");
+        exit(1);
+    }
+
+    /* A filename of "-" means stdin or stdout, and the VCD goes to
+     * stdout when no filename is given. */
+    FILE *in = stdin;
+    if (strcmp(argv[1], "-") != 0)
+        in = fopen(argv[1], "r");
+    if (in == NULL) {
+        perror(argv[1]);
+        exit(1);
+    }
+
+    FILE *out = stdout;
+    if (argc == 3 && strcmp(argv[2], "-") != 0)
+        out = fopen(argv[2], "w");
+    if (out == NULL) {
+        perror(argv[2]);
+        exit(1);
+    }
+
+    std::vector<size_t> widths;
+    std::vector<std::string> names;
+    std::vector<std::vector<uint64_t>> values;
+    std::vector<std::vector<uint64_t>> printed;
+
+    int tag;
+    while ((tag = getc(in)) != EOF) {
+        switch (tag) {
+        case TRACE_HEADER:
+        {
+            char magic[sizeof(TRACE_MAGIC)] = {0};
+            uint64_t version, count;
+            std::string header;
+            if (fread(magic, 1, strlen(TRACE_MAGIC), in) != strlen(TRACE_MAGIC)
+                || strcmp(magic, TRACE_MAGIC) != 0
+                || trace_get_varint(in, version) == false
+                || version != TRACE_VERSION
+                || trace_get_string(in, header) == false
+                || trace_get_varint(in, count) == false) {
+                fprintf(stderr, "%s: bad trace header\n", argv[1]);
+                exit(1);
+            }
+
+            widths.clear();
+            names.clear();
+            for (uint64_t i = 0; i < count; ++i) {
+                uint64_t width;
+                std::string name;
+                if (trace_get_varint(in, width) == false
+                    || trace_get_string(in, name) == false) {
+                    fprintf(stderr, "%s: bad trace header\n", argv[1]);
+                    exit(1);
+                }
+
+                widths.push_back(width);
+                names.push_back(name);
+            }
+
+            values.assign(count, std::vector<uint64_t>());
+            printed.assign(count, std::vector<uint64_t>());
+            for (uint64_t i = 0; i < count; ++i) {
+                values[i].assign((widths[i] + 63) / 64, 0);
+                printed[i].assign((widths[i] + 63) / 64, 0);
+            }
+
+            fputs(header.c_str(), out);
+            break;
+        }
+
+        case TRACE_KEYFRAME:
+        case TRACE_CYCLE:
+            if (convert_record(in, out, tag == TRACE_KEYFRAME,
+                               widths, names, values, printed) == false) {
+                fprintf(stderr, "%s: trace ends in the middle of a cycle\n",
+                        argv[1]);
+                exit(1);
+            }
+            break;
+
+        default:
+            fprintf(stderr, "%s: unknown record '%c'\n", argv[1], tag);
+            exit(1);
+        }
+    }
+
+    if (in != stdin)
+        fclose(in);
+    if (out != stdout)
+        fclose(out);
+
+    return 0;
+}
+
+bool convert_record(FILE *in, FILE *out, bool keyframe,
+                    const std::vector<size_t>& widths,
+                    const std::vector<std::string>& names,
+                    std::vector<std::vector<uint64_t>>& values,
+                    std::vector<std::vector<uint64_t>>& printed)
+{
+    uint64_t cycle;
+    if (trace_get_varint(in, cycle) == false)
+        return false;
+
+    fprintf(out, "#%lu\n", (unsigned long)cycle);
+
+    /* Signals are listed in order, each one as the distance from the
+     * one after the previous signal. */
+    size_t i = 0;
+    while (true) {
+        uint64_t skip;
+        if (trace_get_varint(in, skip) == false)
+            return false;
+        if (skip == 0)
+            return true;
+
+        i += skip - 1;
+        if (i >= values.size()) {
+            fprintf(stderr, "Signal %lu isn't in the trace header\n",
+                    (unsigned long)i);
+            exit(1);
+        }
+
+        for (auto& word: values[i]) {
+            uint64_t delta;
+            if (trace_get_varint(in, delta) == false)
+                return false;
+
+            word = keyframe ? delta : (word ^ delta);
+        }
+
+        /* Exactly like the VCD writer, a value is only written out
+         * when it's different than the last one that was written. */
+        if (cycle == 0 || values[i] != printed[i]) {
+            std::string line = "b";
+            for (size_t b = widths[i]; b > 0; --b)
+                line += ((values[i][(b - 1) / 64] >> ((b - 1) % 64)) & 1) ? '1' : '0';
+            line += " " + names[i] + "\n";
+            fputs(line.c_str(), out);
+
+            printed[i] = values[i];
+        }
+
+        i++;
+    }
+}
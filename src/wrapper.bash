@@ -23,6 +23,26 @@ then
     shift
 fi
 
+# Any other flags change how code is generated.  They need to be passed
+# to every generation step, as they change the interface between the
+# generated files.
+genopts=""
+jit="false"
+cache="$FLO_LLVM_CACHE"
+while [[ "$1" == --* && "$1" != "--help" && "$1" != "--version" ]]
+do
+    if [[ "$1" == "--jit" ]]
+    then
+        jit="true"
+    elif [[ "$1" == --cache=* ]]
+    then
+        cache="${1#--cache=}"
+    else
+        genopts="$genopts $1"
+    fi
+    shift
+done
+
 # If we weren't passed an input then just send the help text.
 input="$1"
 if [[ "$input" == "" ]]
@@ -67,27 +87,139 @@ if [[ "$input" == "--help" ]]
 then
     echo "$0 <DESIGN.flo>: Converts Flo files to LLVM IR"
     echo "    The output will be DESIGN.h and DESIGN.o"
+    echo "  --native-state: Generated code accesses a flat state struct"
+    echo "  --jit:          Builds everything inside a single process"
+    echo "  --cycles=N:     With --jit, runs N cycles instead of writing files"
+    echo "  --lanes=N:      Simulates N copies of the design with vectors"
+    echo "  --threads=N:    Splits each cycle between N threads (link with -pthread)"
+    echo "  --chunk=N:      Splits each cycle into functions of size N, which"
+    echo "                  are compiled as separate modules in parallel"
+    echo "  --cache=DIR:    Reuses compiled modules from DIR (or \$FLO_LLVM_CACHE)"
+    echo "  --activity:     Skips logic whose inputs didn't change"
+    echo "  --binary-trace: Dumps a binary trace, see flo-llvm-trace2vcd"
+    echo "  --optimize:     Optimizes the Flo graph before generating code"
+    echo "  --pass-stats:   Reports the graph's size around every pass"
+    echo "  --profile:      Counts the cycles clock_lo spends on each class"
+    echo "                  of operation, see dump_profile()"
     exit 0
 fi
 
+# The JIT does everything in a single process, including writing out
+# the .o and .h files.
+if [[ "$jit" == "true" ]]
+then
+    exec $0-$mode "$input" --jit $genopts
+fi
+
 tempdir=`mktemp -d -t flo-llvm-wrapper.XXXXXXXXXX`
 trap "rm -rf $tempdir" EXIT
 
-$0-$mode "$input" --header > $tempdir/design.h
-$0-$mode "$input" --compat > $tempdir/compat.c++
-$0-$mode "$input" --ir     > $tempdir/design.llvm
+start="$(date +%s.%N)"
+
+# Keeps track of the peak memory usage of every step, but only when
+# there's a GNU time to measure it with.
+measure() {
+    if test -x /usr/bin/time
+    then
+        /usr/bin/time -a -o $tempdir/rss -f "%M" "$@"
+    else
+        "$@"
+    fi
+}
+
+# Builds a single LLVM module into an object file.  When there's a
+# cache the object is keyed by a hash of the module along with the
+# tools that build it, so a module that hasn't changed since the last
+# time it was built never needs to be built again.
+compile() {
+    if [[ "$cache" != "" ]]
+    then
+        key="$(cat "$1.llvm" $tempdir/toolchain | sha1sum | cut -d' ' -f1)"
+        if test -f "$cache/$key.o"
+        then
+            cp "$cache/$key.o" "$1.o"
+            touch "$1.hit"
+            return 0
+        fi
+    fi
+
+    measure $opt -O2 "$1.llvm" -o "$1.opt" || return 1
+    measure $llc -O2 "$1.opt" -o "$1.S" || return 1
+    measure c++ "$1.S" -c -o "$1.o" || return 1
+
+    if [[ "$cache" != "" ]]
+    then
+        mkdir -p "$cache"
+        cp "$1.o" "$cache/$key.o.$$"
+        mv -f "$cache/$key.o.$$" "$cache/$key.o"
+    fi
+}
+
+measure $0-$mode "$input" --header $genopts > $tempdir/design.h
+measure $0-$mode "$input" --compat $genopts > $tempdir/compat.c++
+
+# When clock_lo is split into chunks every one of them goes into its
+# own module, which keeps the optimizer from having to deal with one
+# enormous function and allows the modules to be built in parallel.
+pieces=""
+if [[ "$genopts" == *--chunk=* ]]
+then
+    measure $0-$mode "$input" --ir-split $genopts > $tempdir/split.llvm
+    awk -v dir="$tempdir" \
+        '/^; flo-llvm module / { if (f != "") close(f); f = dir "/" $4 ".llvm"; next }
+         { print > f }' \
+        $tempdir/split.llvm
+    pieces="$(grep "^; flo-llvm module _" $tempdir/split.llvm | cut -d' ' -f4)"
+else
+    measure $0-$mode "$input" --ir $genopts > $tempdir/design.llvm
+fi
 
-$clang -c -S -emit-llvm \
-    -I "$(dirname $input)" \
-    -include $tempdir/design.h \
-    $tempdir/compat.c++ -o $tempdir/compat.llvm
+# The compatibility layer is built from inside $tempdir: clang names
+# the module after the file it was given, and a name that's different
+# on every run would keep the link module from ever hitting the cache.
+incdir="$(cd "$(dirname $input)" && pwd)"
+(
+    cd $tempdir
+    measure $clang -c -S -emit-llvm -std=c++11 \
+        -I "$incdir" \
+        -include design.h \
+        compat.c++ -o compat.llvm
+)
 
 $llvm_link $tempdir/design.llvm $tempdir/compat.llvm > $tempdir/link.llvm
 
-$opt -O2 $tempdir/link.llvm -o $tempdir/opt.llvm
-$llc -O2 $tempdir/opt.llvm -o $tempdir/opt.S
+{ $opt --version; $llc --version; c++ --version; } > $tempdir/toolchain 2>&1
 
-c++ $tempdir/opt.S -c -o $tempdir/opt.o
+export -f measure compile
+export opt llc cache tempdir
+echo link $pieces | tr ' ' '\n' \
+    | xargs -P "$(nproc 2>/dev/null || echo 1)" -I{} \
+        bash -c 'compile "$tempdir/{}"' \
+    || exit 1
+
+if [[ "$pieces" == "" ]]
+then
+    mv $tempdir/link.o $tempdir/opt.o
+else
+    ld -r -o $tempdir/opt.o $tempdir/link.o \
+        $(for p in $pieces; do echo $tempdir/$p.o; done)
+fi
 
 mv $tempdir/opt.o "$(dirname $input)"/"$(basename $input .flo)".o
 mv $tempdir/design.h "$(dirname $input)"/"$(basename $input .flo)".h
+
+# Every run reports how long it took to build the design, how many of
+# its modules came from the cache, and how much memory that needed.
+awk -v s="$start" -v e="$(date +%s.%N)" \
+    'BEGIN { printf "flo-llvm: %-12s %10.3f s\n", "compile", e - s }' >&2
+if [[ "$cache" != "" ]]
+then
+    awk -v h="$(ls $tempdir/*.hit 2>/dev/null | wc -l)" \
+        -v m="$(echo link $pieces | wc -w)" \
+        'BEGIN { printf "flo-llvm: %-12s %d of %d modules\n", "cache hits", h, m }' >&2
+fi
+if test -f $tempdir/rss
+then
+    sort -n $tempdir/rss | tail -n 1 \
+        | awk '{ printf "flo-llvm: %-12s %d KiB\n", "peak RSS", $1 }' >&2
+fi
@@ -0,0 +1,64 @@
+set -e
+set -x
+
+# Benchmarks take a while and their numbers only mean something on an
+# otherwise quiet machine, so they're only run when there's a file to
+# put the results in.  Every run appends to it, which allows results
+# from different versions of flo-llvm to be compared.
+if [[ "$FLO_LLVM_BENCH" == "" ]]
+then
+    exit 0
+fi
+
+# Everything is run in-process, which needs --jit.
+if $PTEST_BINARY --version 2>&1 | grep -q "without --jit"
+then
+    exit 0
+fi
+
+if [[ "$TEST" == "" ]]
+then
+    TEST="test"
+fi
+
+if [[ "$BENCH_OPTS" == "" ]]
+then
+    BENCH_OPTS="--native-state"
+fi
+
+SCALA_FLAGS="-J-Xms512m -J-Xmx900m -J-Xss8m"
+
+# Only the Flo file is needed, there's nothing to compare against.
+if test -f $TEST.scala
+then
+    scalac *.scala -classpath chisel.jar:.
+
+    scala $SCALA_FLAGS -classpath chisel.jar:. $TEST $ARGS \
+        --debug --backend flo \
+        || true
+fi
+
+version="$($PTEST_BINARY --version 2>&1 | cut -d' ' -f1)"
+
+# Every design is built and run in-process, which times each step on
+# its own: "optimize" and "codegen" are what opt and llc do for the
+# wrapper.  The design's inputs are never poked, so it's only the cost
+# of each cycle that's measured (and that's the same between versions).
+# The second run is instrumented, which says where that time goes.
+for opts in "$BENCH_OPTS" "$BENCH_OPTS --profile"
+do
+    time $PTEST_BINARY $TEST.flo --jit --cycles=$BENCH_CYCLES $opts \
+        2> bench.log
+    cat bench.log
+
+    # Results are written one per line as tab-separated fields: the
+    # version, design, options, metric, value and unit.
+    cat bench.log \
+        | sed -n \
+            -e 's@^flo-llvm: profile \([a-z]*\): \([0-9]*\) cycles, \([0-9]*\) ops$@profile-\1\t\2\tcycles\nprofile-\1-ops\t\3\tops@p' \
+            -e 's@^flo-llvm: [0-9]* cycles, \([0-9.]*\) cycles/s$@speed\t\1\tcycles/s@p' \
+            -e 's@^flo-llvm: peak RSS *\([0-9]*\) KiB$@peak-rss\t\1\tKiB@p' \
+            -e 's@^flo-llvm: \([a-z-]*\) *\([0-9.]*\) s$@\1\t\2\ts@p' \
+        | sed "s@^@$version\t$BENCH\t$(echo $opts)\t@" \
+        | tee -a "$FLO_LLVM_BENCH"
+done
@@ -0,0 +1,12 @@
+#include "tempdir.bash"
+#include "chisel-jar.bash"
+
+TEST="DES"
+BENCH="des"
+BENCH_CYCLES="100000"
+
+cat >DES.scala <<EOF
+#include "large_des-scala.bash"
+EOF
+
+#include "bench.bash"
@@ -0,0 +1,24 @@
+#include "tempdir.bash"
+#include "chisel-jar.bash"
+
+TEST="ScaleSpaceExtrema"
+ARGS="Random_160_2_5"
+BENCH="sift-160_2_5"
+BENCH_CYCLES="10000"
+
+cat >>$TEST.tar.gz.base64 <<EOF
+#include "large_sift-tar.bash"
+EOF
+cat $TEST.tar.gz.base64 | base64 --decode | gunzip | tar -x
+
+find . -iname "*.scala" | while read f
+do
+    cat "$f" | sed 's/package SIFT//g' > "$f".sedtmp
+    mv "$f".sedtmp "$f"
+done
+
+cat main.scala | sed 's/object SIFT/object ScaleSpaceExtrema/g' \
+    >> ScaleSpaceExtrema.scala
+rm main.scala
+
+#include "bench.bash"
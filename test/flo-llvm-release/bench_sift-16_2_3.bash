@@ -0,0 +1,24 @@
+#include "tempdir.bash"
+#include "chisel-jar.bash"
+
+TEST="ScaleSpaceExtrema"
+ARGS="Random_16_2_3"
+BENCH="sift-16_2_3"
+BENCH_CYCLES="100000"
+
+cat >>$TEST.tar.gz.base64 <<EOF
+#include "large_sift-tar.bash"
+EOF
+cat $TEST.tar.gz.base64 | base64 --decode | gunzip | tar -x
+
+find . -iname "*.scala" | while read f
+do
+    cat "$f" | sed 's/package SIFT//g' > "$f".sedtmp
+    mv "$f".sedtmp "$f"
+done
+
+cat main.scala | sed 's/object SIFT/object ScaleSpaceExtrema/g' \
+    >> ScaleSpaceExtrema.scala
+rm main.scala
+
+#include "bench.bash"
@@ -0,0 +1,47 @@
+GENOPTS="--profile"
+
+#include "tempdir.bash"
+#include "chisel-jar.bash"
+
+cat >test.scala <<EOF
+import Chisel._
+
+class test extends Module {
+  val io = new Bundle {
+    val a = UInt(INPUT,  width = 128)
+    val b = UInt(INPUT,  width = 128)
+    val o = UInt(OUTPUT, width = 128)
+  }
+
+  io.o := io.a / io.b
+}
+
+class tests(t: test) extends Tester(t) {
+  for (cycle <- 0 until 100) {
+    poke(t.io.a, BigInt(128, rnd))
+    poke(t.io.b, BigInt(64, rnd) + 1)
+    step(1)
+  }
+}
+
+object test {
+  def main(args: Array[String]): Unit = {
+    chiselMainTest(args, () => Module(new test())) { t => new tests(t) }
+  }
+}
+EOF
+
+#include "harness.bash"
+
+# The division is the design's only arithmetic, so every cycle charges
+# exactly one operation to it and none to the classes it doesn't use.
+cat $TEST.stdin | ./opt >/dev/null 2>profile.out
+cat profile.out
+grep "^profile arith: [1-9][0-9]* cycles, [1-9][0-9]* ops$" profile.out
+grep "^profile bits: 0 cycles, 0 ops$" profile.out
+grep "^profile mem: 0 cycles, 0 ops$" profile.out
+
+# Cycle counts are too noisy to compare, but the division must be timed
+# as arithmetic: the first counter that's bumped after it is arith's.
+sed -n '/ = udiv /,$p' $TEST.llvm | grep -m1 "%profile, i64 " \
+    | grep "%profile, i64 2$"
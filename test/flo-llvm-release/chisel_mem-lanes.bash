@@ -0,0 +1,143 @@
+LANES="4"
+
+#include "tempdir.bash"
+
+cat >test.scala <<EOF
+import Chisel._
+
+class test extends Module {
+  val io = new Bundle {
+    val we   = Bool(INPUT)
+    val addr = UInt(INPUT,  width = 4)
+    val d    = UInt(INPUT,  width = 70)
+    val o    = UInt(OUTPUT, width = 70)
+  }
+
+  val mem = Mem(UInt(width = 70), 16)
+
+  val r = Reg(init = UInt(0, width = 70))
+  when (io.we)  { mem(io.addr) := io.d ^ r }
+  when (!io.we) { r := r + mem(io.addr) }
+
+  io.o := r
+}
+
+class tests(t: test) extends Tester(t) {
+  var cycle = 0
+  do {
+    poke(t.io.addr, cycle % 16)
+    poke(t.io.d, (BigInt(cycle) << 60) + BigInt(cycle) * 9781)
+    poke(t.io.we, 1)
+    step(1)
+
+    poke(t.io.addr, cycle % 16)
+    poke(t.io.we, 0)
+    step(1)
+
+    cycle += 1
+  } while (cycle < 1000)
+}
+
+object test {
+  def main(args: Array[String]): Unit = {
+    chiselMainTest(args, () => Module(new test())) { t => new tests(t) }
+  }
+}
+EOF
+
+# Every lane reads and writes different addresses with different data,
+# some of which hasn't been written yet.
+cat >stimulus.h <<EOF
+#include <stdint.h>
+#include <stdlib.h>
+
+static void stimulus(size_t lane, size_t cycle,
+                     bool *we, uint64_t *addr, uint64_t d[2])
+{
+    uint64_t x = (cycle + 1) * 0x9e3779b97f4a7c15ULL
+        + lane * 0x2545f4914f6cdd1dULL;
+
+    *we = ((cycle / 3) + lane) % 2;
+    *addr = (x >> 32) % 16;
+    d[0] = x;
+    d[1] = x >> 58;
+}
+EOF
+
+cat >lanes.c++ <<EOF
+#include <inttypes.h>
+#include <stdio.h>
+#include "stimulus.h"
+
+int main(void)
+{
+    test_t *t = new test_t();
+    t->init();
+    t->clock(true);
+
+    for (size_t cycle = 0; cycle < 1000; ++cycle) {
+        for (size_t lane = 0; lane < test_t::lanes; ++lane) {
+            bool we;
+            uint64_t addr, d[2];
+            stimulus(lane, cycle, &we, &addr, d);
+
+            t->poke_test__io_we(lane, we);
+            t->poke_test__io_addr(lane, addr);
+            t->poke_test__io_d(lane, d[0], 0);
+            t->poke_test__io_d(lane, d[1], 1);
+        }
+
+        t->clock(false);
+
+        for (size_t lane = 0; lane < test_t::lanes; ++lane) {
+            printf("%lu %lu %016" PRIx64 "%016" PRIx64 "\n",
+                   (unsigned long)lane, (unsigned long)cycle,
+                   t->peek_test__io_o(lane, 1),
+                   t->peek_test__io_o(lane, 0));
+        }
+    }
+
+    return 0;
+}
+EOF
+
+cat >lane.c++ <<EOF
+#include <inttypes.h>
+#include <stdio.h>
+#include "stimulus.h"
+
+int main(int argc, char **argv)
+{
+    size_t lane = (argc > 1) ? atoi(argv[1]) : 0;
+
+    test_t *t = new test_t();
+    t->init();
+    t->clock(LIT<1>(1));
+
+    for (size_t cycle = 0; cycle < 1000; ++cycle) {
+        bool we;
+        uint64_t addr, d[2];
+        stimulus(lane, cycle, &we, &addr, d);
+
+        dat_t<70> dd;
+        dd.values[0] = d[0];
+        dd.values[1] = d[1] & ((1ULL << 6) - 1);
+
+        t->test__io_we = LIT<1>(we);
+        t->test__io_addr = LIT<4>(addr);
+        t->test__io_d = dd;
+
+        t->clock(LIT<1>(0));
+
+        printf("%lu %lu %016" PRIx64 "%016" PRIx64 "\n",
+               (unsigned long)lane, (unsigned long)cycle,
+               (uint64_t)t->test__io_o.values[1],
+               (uint64_t)t->test__io_o.values[0]);
+    }
+
+    return 0;
+}
+EOF
+
+#include "chisel-jar.bash"
+#include "harness.bash"
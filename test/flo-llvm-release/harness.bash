@@ -23,6 +23,16 @@ then
     fi
 fi
 
+# flo-llvm is only built with --jit when there's an LLVM to link
+# against, so there's nothing to test without one.
+if [[ "$JIT" == "true" ]]
+then
+    if $PTEST_BINARY --version 2>&1 | grep -q "without --jit"
+    then
+        exit 0
+    fi
+fi
+
 for arch in "$(echo $FAILING_ARCHES)"
 do
     if [[ "$arch" == "$(uname -m)" ]]
@@ -101,11 +111,11 @@ fi
 
 # Builds the rest of the C++ emulator, which contains a main() that
 # actually runs the code.
-time $PTEST_BINARY $TEST.flo --header > $TEST.h
+time $PTEST_BINARY $TEST.flo --header $GENOPTS > $TEST.h
 
 if [[ "$have_valgrind" == "true" ]]
 then
-    valgrind --log-file=vg-$TEST.h -q $PTEST_BINARY $TEST.flo --header >$TEST-vg.h || true
+    valgrind --log-file=vg-$TEST.h -q $PTEST_BINARY $TEST.flo --header $GENOPTS >$TEST-vg.h || true
     cat vg-$TEST.h
     if [[ "$(cat vg-$TEST.h | wc -l)" != "0" ]]
     then
@@ -113,11 +123,11 @@ then
     fi
 fi
 
-time $PTEST_BINARY $TEST.flo --compat > compat.c++
+time $PTEST_BINARY $TEST.flo --compat $GENOPTS > compat.c++
 
 if [[ "$have_valgrind" == "true" ]]
 then
-    valgrind --log-file=vg-compat.c++ -q $PTEST_BINARY $TEST.flo --compat >compat-vg.c++ || true
+    valgrind --log-file=vg-compat.c++ -q $PTEST_BINARY $TEST.flo --compat $GENOPTS >compat-vg.c++ || true
     cat vg-compat.c++
     if [[ "$(cat vg-compat.c++ | wc -l)" != "0" ]]
     then
@@ -125,12 +135,12 @@ then
     fi
 fi
 
-time $PTEST_BINARY $TEST.flo --harness > harness.c++
+time $PTEST_BINARY $TEST.flo --harness $GENOPTS > harness.c++
 cat harness.c++
 
 if [[ "$have_valgrind" == "true" ]]
 then
-    valgrind --log-file=vg-harness.c++ -q $PTEST_BINARY $TEST.flo --harness >harness-vg.c++ || true
+    valgrind --log-file=vg-harness.c++ -q $PTEST_BINARY $TEST.flo --harness $GENOPTS >harness-vg.c++ || true
     cat vg-harness.c++
     if [[ "$(cat vg-harness.c++ | wc -l)" != "0" ]]
     then
@@ -138,40 +148,72 @@ then
     fi
 fi
 
-time $clang -g -c -std=c++11 harness.c++ -o harness.llvm -S -emit-llvm
-#cat harness.llvm
+if [[ "$JIT" == "true" ]]
+then
+    # Builds the whole design with a single invocation of flo-llvm,
+    # which writes out both $TEST.o and $TEST.h.
+    time $PTEST_BINARY $TEST.flo --jit $GENOPTS
 
-time $clang -g -c -include $TEST.h -std=c++11 compat.c++ \
-    -o compat.llvm -S -emit-llvm
-#cat compat.llvm
+    # Just like the wrapper's, the header can be included by more than
+    # one C++ file.
+    echo "#include \"$TEST.h\"" > other.c++
+    c++ -g -std=c++11 harness.c++ other.c++ $TEST.o -o opt -pthread
+else
+    time $clang -g -c -std=c++11 harness.c++ -o harness.llvm -S -emit-llvm
+    #cat harness.llvm
 
-# Preforms the Flo->LLVM conversion to generate the actual clock
-# lines.
-time $PTEST_BINARY $TEST.flo --ir > $TEST.llvm
+    time $clang -g -c -include $TEST.h -std=c++11 compat.c++ \
+        -o compat.llvm -S -emit-llvm
+    #cat compat.llvm
 
-if [[ "$have_valgrind" == "true" ]]
-then
-    valgrind --log-file=vg-$TEST.llvm -q $PTEST_BINARY $TEST.flo --ir >$TEST-vg.llvm || true
-    cat vg-$TEST.llvm
-    if [[ "$(cat vg-$TEST.llvm | wc -l)" != "0" ]]
+    # Preforms the Flo->LLVM conversion to generate the actual clock
+    # lines.  Split designs have every chunk of clock_lo in its own
+    # module, which is built separately just like the wrapper does.
+    pieces=""
+    if [[ "$SPLIT" == "true" ]]
     then
-        exit 1
+        time $PTEST_BINARY $TEST.flo --ir-split $GENOPTS > split.llvm
+        awk '/^; flo-llvm module / { if (f != "") close(f); f = $4 ".llvm"; next }
+             { print > f }' \
+            split.llvm
+        mv design.llvm $TEST.llvm
+        pieces="$(grep "^; flo-llvm module _" split.llvm | cut -d' ' -f4)"
+    else
+        time $PTEST_BINARY $TEST.flo --ir $GENOPTS > $TEST.llvm
     fi
-fi
 
-# Links together all the bitcode files
-time $llvm_link $TEST.llvm compat.llvm harness.llvm -S > exe.llvm
-#cat exe.llvm
+    if [[ "$have_valgrind" == "true" ]]
+    then
+        valgrind --log-file=vg-$TEST.llvm -q $PTEST_BINARY $TEST.flo --ir $GENOPTS >$TEST-vg.llvm || true
+        cat vg-$TEST.llvm
+        if [[ "$(cat vg-$TEST.llvm | wc -l)" != "0" ]]
+        then
+            exit 1
+        fi
+    fi
+
+    # Links together all the bitcode files
+    time $llvm_link $TEST.llvm compat.llvm harness.llvm -S > exe.llvm
+    #cat exe.llvm
+
+    # Optimizes the assembly that was generated.  I'm not sure if this is
+    # necessary to do before I stick in inside the JIT or not...
+    time $opt -O2 exe.llvm -S > opt.llvm
+    #cat opt.llvm
 
-# Optimizes the assembly that was generated.  I'm not sure if this is
-# necessary to do before I stick in inside the JIT or not...
-time $opt -O2 exe.llvm -S > opt.llvm
-#cat opt.llvm
+    # Runs the new emulator inside the LLVM interpreter (or probably JIT
+    # compiler, if you're using a sane architecture).
+    $llc -O2 opt.llvm -o opt.S
+
+    for p in $pieces
+    do
+        $opt -O2 $p.llvm -o $p.opt
+        $llc -O2 $p.opt -o $p.S
+    done
+
+    c++ -g opt.S $(for p in $pieces; do echo $p.S; done) -o opt -pthread
+fi
 
-# Runs the new emulator inside the LLVM interpreter (or probably JIT
-# compiler, if you're using a sane architecture).
-$llc -O2 opt.llvm -o opt.S
-c++ -g opt.S -o opt
 if test -f $TEST.stdin
 then
     cp $TEST.stdin $TEST.stdin.copy
@@ -208,7 +250,61 @@ then
     fi
 fi
 
+# A binary trace needs to be converted back to VCD before it can be
+# compared.
+if [[ "$TRACE" == "true" ]]
+then
+    mv $TEST.vcd $TEST.trace
+    $(dirname $PTEST_BINARY)/flo-llvm-trace2vcd $TEST.trace $TEST.vcd
+fi
+
 # Ensures that the two VCD files are actually the same.  Note that
 # this allows extra signals to exist in the test file, but at least
 # every signal from the gold file must exist.
 time vcddiff gold.vcd $TEST.vcd
+
+# Designs with more than one lane don't have the interface Chisel's
+# harness drives, so the test drives them itself: lanes.c++ gives each
+# lane its own stimulus, and lane.c++ gives a single-lane build the
+# stimulus of the lane named on its command line.  Every lane must
+# match the single-lane build.
+if [[ "$LANES" != "" ]]
+then
+    for build in lanes lane
+    do
+        lopts="$GENOPTS"
+        if [[ "$build" == "lanes" ]]
+        then
+            lopts="$GENOPTS --lanes=$LANES"
+        fi
+
+        $PTEST_BINARY $TEST.flo --header $lopts > $build.h
+        $PTEST_BINARY $TEST.flo --compat $lopts > $build-compat.c++
+        $PTEST_BINARY $TEST.flo --ir $lopts > $build-design.llvm
+
+        $clang -g -c -include $build.h -std=c++11 $build-compat.c++ \
+            -o $build-compat.llvm -S -emit-llvm
+        $clang -g -c -include $build.h -std=c++11 $build.c++ \
+            -o $build-driver.llvm -S -emit-llvm
+
+        $llvm_link $build-design.llvm $build-compat.llvm $build-driver.llvm \
+            -S > $build-exe.llvm
+        $opt -O2 $build-exe.llvm -S > $build-opt.llvm
+        $llc -O2 $build-opt.llvm -o $build-opt.S
+        c++ -g $build-opt.S -o $build -pthread
+    done
+
+    time ./lanes > lanes.out
+
+    for lane in $(seq 0 $(($LANES - 1)))
+    do
+        ./lane $lane > lane-$lane.out
+        grep "^$lane " lanes.out | diff - lane-$lane.out
+    done
+
+    # Lanes that all compute the same thing wouldn't catch much.
+    if [[ "$(diff <(cut -d' ' -f2- lane-0.out) <(cut -d' ' -f2- lane-1.out) | wc -l)" == "0" ]]
+    then
+        exit 1
+    fi
+fi
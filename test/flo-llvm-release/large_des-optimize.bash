@@ -0,0 +1,14 @@
+GENOPTS="--optimize"
+
+#include "tempdir.bash"
+#include "chisel-jar.bash"
+
+TEST="DES"
+LARGE="true"
+FAILING_ARCHES="i686"
+
+cat >DES.scala <<EOF
+#include "large_des-scala.bash"
+EOF
+
+#include "harness.bash"
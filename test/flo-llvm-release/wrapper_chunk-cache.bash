@@ -0,0 +1,68 @@
+#include "tempdir.bash"
+
+# The wrapper is installed right next to every flo-llvm binary, and
+# picks which one to run from its first argument.
+wrapper="$(dirname $PTEST_BINARY)/flo-llvm"
+mode="--$(basename $PTEST_BINARY | sed 's/^flo-llvm-//')"
+
+# A design that's split into many chunks, which can have one more
+# register added right in the middle of it.
+design() {
+    echo "test::reset = rst'1"
+    echo "test::io_i = in'32"
+    for i in $(seq 0 63)
+    do
+        if [[ "$1" == "edit" && "$i" == "32" ]]
+        then
+            echo "test::x = reg'32 1 XA"
+            echo "XM = mul'32 test::x 7'32"
+            echo "XA = add'32 XM test::io_i"
+            echo "test::io_x = out'32 test::x"
+        fi
+
+        echo "test::r$i = reg'32 1 A$i"
+        echo "M$i = mul'32 test::r$i 33'32"
+        echo "A$i = add'32 M$i test::io_i"
+        echo "test::io_o$i = out'32 test::r$i"
+    done
+}
+
+hits() {
+    grep "^flo-llvm: cache hits" $1 | sed 's@^.* \([0-9]*\) of \([0-9]*\) modules$@\1@'
+}
+
+modules() {
+    grep "^flo-llvm: cache hits" $1 | sed 's@^.* \([0-9]*\) of \([0-9]*\) modules$@\2@'
+}
+
+design > test.flo
+$wrapper $mode --chunk=64 --cache=$PWD/cache test.flo 2> build1.log
+cat build1.log
+test -f test.o
+if [[ "$(hits build1.log)" != "0" ]]
+then
+    exit 1
+fi
+
+# Nothing changed, so every module comes from the cache.
+$wrapper $mode --chunk=64 --cache=$PWD/cache test.flo 2> build2.log
+cat build2.log
+if [[ "$(hits build2.log)" != "$(modules build2.log)" ]]
+then
+    exit 1
+fi
+
+# The new register changes the link module, which holds the layout of
+# the state, and the chunk it lands in (which might be split in two).
+# Every other chunk is exactly the same as before.
+design edit > test.flo
+$wrapper $mode --chunk=64 --cache=$PWD/cache test.flo 2> build3.log
+cat build3.log
+if [[ "$(modules build3.log)" -lt "8" ]]
+then
+    exit 1
+fi
+if [[ "$(hits build3.log)" -lt "$(expr $(modules build3.log) - 3)" ]]
+then
+    exit 1
+fi